@@ -0,0 +1,549 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "aabbtree.h"
+
+#define AABBTREE_STACK_SIZE		256
+
+// Traversal stack, lives on the C stack and only touches the heap for very deep trees
+struct TreeStack
+{
+	int* items;
+	int count;
+	int capacity;
+	int local[AABBTREE_STACK_SIZE];
+};
+
+static void StackInit(TreeStack* stack)
+{
+	stack->items = stack->local;
+	stack->count = 0;
+	stack->capacity = AABBTREE_STACK_SIZE;
+}
+
+static void StackPush(TreeStack* stack, int item)
+{
+	if (stack->count == stack->capacity)
+	{
+		int* items = (int*)malloc(sizeof(int) * stack->capacity * 2);
+		memcpy(items, stack->items, sizeof(int) * stack->count);
+		if (stack->items != stack->local) free(stack->items);
+		stack->items = items;
+		stack->capacity *= 2;
+	}
+	stack->items[stack->count++] = item;
+}
+
+static int StackPop(TreeStack* stack)
+{
+	assert(stack->count > 0);
+	return stack->items[--stack->count];
+}
+
+static void StackFree(TreeStack* stack)
+{
+	if (stack->items != stack->local) free(stack->items);
+}
+
+static inline AABB Combine(AABB a, AABB b)
+{
+	AABB result;
+	result.min = V2(a.min.x < b.min.x ? a.min.x : b.min.x, a.min.y < b.min.y ? a.min.y : b.min.y);
+	result.max = V2(a.max.x > b.max.x ? a.max.x : b.max.x, a.max.y > b.max.y ? a.max.y : b.max.y);
+	return result;
+}
+
+static inline float Perimeter(AABB a)
+{
+	return 2.0f * ((a.max.x - a.min.x) + (a.max.y - a.min.y));
+}
+
+static inline bool IsLeaf(const AabbTreeNode* node)
+{
+	return node->child1 == AABBTREE_NULL_NODE;
+}
+
+static inline int MaxInt(int a, int b)
+{
+	return a > b ? a : b;
+}
+
+static int AllocateNode(AabbTree* tree)
+{
+	if (tree->freeList == AABBTREE_NULL_NODE)
+	{
+		assert(tree->nodeCount == tree->nodeCapacity);
+		tree->nodeCapacity *= 2;
+		tree->nodes = (AabbTreeNode*)realloc(tree->nodes, sizeof(AabbTreeNode) * tree->nodeCapacity);
+		for (int i = tree->nodeCount; i < tree->nodeCapacity; i++)
+		{
+			tree->nodes[i].next = i + 1;
+			tree->nodes[i].height = -1;
+		}
+		tree->nodes[tree->nodeCapacity - 1].next = AABBTREE_NULL_NODE;
+		tree->freeList = tree->nodeCount;
+	}
+
+	int nodeId = tree->freeList;
+	AabbTreeNode* node = &tree->nodes[nodeId];
+	tree->freeList = node->next;
+	node->parent = AABBTREE_NULL_NODE;
+	node->child1 = AABBTREE_NULL_NODE;
+	node->child2 = AABBTREE_NULL_NODE;
+	node->height = 0;
+	node->userData = -1;
+	tree->nodeCount++;
+	return nodeId;
+}
+
+static void FreeNode(AabbTree* tree, int nodeId)
+{
+	assert(0 <= nodeId && nodeId < tree->nodeCapacity);
+	tree->nodes[nodeId].next = tree->freeList;
+	tree->nodes[nodeId].height = -1;
+	tree->freeList = nodeId;
+	tree->nodeCount--;
+}
+
+// Rotates node A up if it's unbalanced. Returns the new root of the subtree.
+static int Balance(AabbTree* tree, int iA)
+{
+	AabbTreeNode* nodes = tree->nodes;
+	AabbTreeNode* A = &nodes[iA];
+	if (IsLeaf(A) || A->height < 2)
+	{
+		return iA;
+	}
+
+	int iB = A->child1;
+	int iC = A->child2;
+	AabbTreeNode* B = &nodes[iB];
+	AabbTreeNode* C = &nodes[iC];
+	int balance = C->height - B->height;
+
+	// Rotate C up
+	if (balance > 1)
+	{
+		int iF = C->child1;
+		int iG = C->child2;
+		AabbTreeNode* F = &nodes[iF];
+		AabbTreeNode* G = &nodes[iG];
+
+		C->child1 = iA;
+		C->parent = A->parent;
+		A->parent = iC;
+		if (C->parent != AABBTREE_NULL_NODE)
+		{
+			if (nodes[C->parent].child1 == iA) nodes[C->parent].child1 = iC;
+			else                               nodes[C->parent].child2 = iC;
+		}
+		else
+		{
+			tree->root = iC;
+		}
+
+		if (F->height > G->height)
+		{
+			C->child2 = iF;
+			A->child2 = iG;
+			G->parent = iA;
+			A->aabb = Combine(B->aabb, G->aabb);
+			C->aabb = Combine(A->aabb, F->aabb);
+			A->height = 1 + MaxInt(B->height, G->height);
+			C->height = 1 + MaxInt(A->height, F->height);
+		}
+		else
+		{
+			C->child2 = iG;
+			A->child2 = iF;
+			F->parent = iA;
+			A->aabb = Combine(B->aabb, F->aabb);
+			C->aabb = Combine(A->aabb, G->aabb);
+			A->height = 1 + MaxInt(B->height, F->height);
+			C->height = 1 + MaxInt(A->height, G->height);
+		}
+		return iC;
+	}
+
+	// Rotate B up
+	if (balance < -1)
+	{
+		int iD = B->child1;
+		int iE = B->child2;
+		AabbTreeNode* D = &nodes[iD];
+		AabbTreeNode* E = &nodes[iE];
+
+		B->child1 = iA;
+		B->parent = A->parent;
+		A->parent = iB;
+		if (B->parent != AABBTREE_NULL_NODE)
+		{
+			if (nodes[B->parent].child1 == iA) nodes[B->parent].child1 = iB;
+			else                               nodes[B->parent].child2 = iB;
+		}
+		else
+		{
+			tree->root = iB;
+		}
+
+		if (D->height > E->height)
+		{
+			B->child2 = iD;
+			A->child1 = iE;
+			E->parent = iA;
+			A->aabb = Combine(C->aabb, E->aabb);
+			B->aabb = Combine(A->aabb, D->aabb);
+			A->height = 1 + MaxInt(C->height, E->height);
+			B->height = 1 + MaxInt(A->height, D->height);
+		}
+		else
+		{
+			B->child2 = iE;
+			A->child1 = iD;
+			D->parent = iA;
+			A->aabb = Combine(C->aabb, D->aabb);
+			B->aabb = Combine(A->aabb, E->aabb);
+			A->height = 1 + MaxInt(C->height, D->height);
+			B->height = 1 + MaxInt(A->height, E->height);
+		}
+		return iB;
+	}
+
+	return iA;
+}
+
+// Walks up from nodeId fixing heights and AABBs, rebalancing on the way
+static void Refit(AabbTree* tree, int nodeId)
+{
+	while (nodeId != AABBTREE_NULL_NODE)
+	{
+		nodeId = Balance(tree, nodeId);
+
+		AabbTreeNode* node = &tree->nodes[nodeId];
+		AabbTreeNode* child1 = &tree->nodes[node->child1];
+		AabbTreeNode* child2 = &tree->nodes[node->child2];
+		node->height = 1 + MaxInt(child1->height, child2->height);
+		node->aabb = Combine(child1->aabb, child2->aabb);
+
+		nodeId = node->parent;
+	}
+}
+
+static void InsertLeaf(AabbTree* tree, int leaf)
+{
+	tree->leafCount++;
+	if (tree->root == AABBTREE_NULL_NODE)
+	{
+		tree->root = leaf;
+		tree->nodes[leaf].parent = AABBTREE_NULL_NODE;
+		return;
+	}
+
+	// Find the best sibling (surface area heuristic, perimeter in 2D)
+	AABB leafAABB = tree->nodes[leaf].aabb;
+	int index = tree->root;
+	while (!IsLeaf(&tree->nodes[index]))
+	{
+		AabbTreeNode* node = &tree->nodes[index];
+		int child1 = node->child1;
+		int child2 = node->child2;
+
+		float area = Perimeter(node->aabb);
+		float combinedArea = Perimeter(Combine(node->aabb, leafAABB));
+
+		// Cost of creating a new parent for this node and the new leaf
+		float cost = 2.0f * combinedArea;
+		// Minimum cost of pushing the leaf further down the tree
+		float inheritanceCost = 2.0f * (combinedArea - area);
+
+		float cost1 = Perimeter(Combine(leafAABB, tree->nodes[child1].aabb)) + inheritanceCost;
+		if (!IsLeaf(&tree->nodes[child1])) cost1 -= Perimeter(tree->nodes[child1].aabb);
+		float cost2 = Perimeter(Combine(leafAABB, tree->nodes[child2].aabb)) + inheritanceCost;
+		if (!IsLeaf(&tree->nodes[child2])) cost2 -= Perimeter(tree->nodes[child2].aabb);
+
+		if (cost < cost1 && cost < cost2) break;
+
+		index = cost1 < cost2 ? child1 : child2;
+	}
+	int sibling = index;
+
+	// Create a new parent for the sibling and the leaf
+	int oldParent = tree->nodes[sibling].parent;
+	int newParent = AllocateNode(tree);
+	AabbTreeNode* nodes = tree->nodes; // AllocateNode may have moved the nodes
+	nodes[newParent].parent = oldParent;
+	nodes[newParent].aabb = Combine(leafAABB, nodes[sibling].aabb);
+	nodes[newParent].height = nodes[sibling].height + 1;
+	nodes[newParent].child1 = sibling;
+	nodes[newParent].child2 = leaf;
+	nodes[sibling].parent = newParent;
+	nodes[leaf].parent = newParent;
+
+	if (oldParent != AABBTREE_NULL_NODE)
+	{
+		if (nodes[oldParent].child1 == sibling) nodes[oldParent].child1 = newParent;
+		else                                    nodes[oldParent].child2 = newParent;
+	}
+	else
+	{
+		tree->root = newParent;
+	}
+
+	Refit(tree, nodes[leaf].parent);
+}
+
+static void RemoveLeaf(AabbTree* tree, int leaf)
+{
+	tree->leafCount--;
+	if (leaf == tree->root)
+	{
+		tree->root = AABBTREE_NULL_NODE;
+		return;
+	}
+
+	AabbTreeNode* nodes = tree->nodes;
+	int parent = nodes[leaf].parent;
+	int grandParent = nodes[parent].parent;
+	int sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+
+	if (grandParent != AABBTREE_NULL_NODE)
+	{
+		// Destroy the parent and connect the sibling to the grand parent
+		if (nodes[grandParent].child1 == parent) nodes[grandParent].child1 = sibling;
+		else                                     nodes[grandParent].child2 = sibling;
+		nodes[sibling].parent = grandParent;
+		FreeNode(tree, parent);
+
+		Refit(tree, grandParent);
+	}
+	else
+	{
+		tree->root = sibling;
+		nodes[sibling].parent = AABBTREE_NULL_NODE;
+		FreeNode(tree, parent);
+	}
+}
+
+static AABB Fatten(const AabbTree* tree, AABB aabb)
+{
+	Vector2 margin = V2(tree->fatMargin, tree->fatMargin);
+	return AabbNew(aabb.min - margin, aabb.max + margin);
+}
+
+void AabbTree_Init(AabbTree* tree, int initialCapacity, float fatMargin)
+{
+	assert(initialCapacity > 0);
+	tree->nodeCapacity = initialCapacity;
+	tree->nodes = (AabbTreeNode*)malloc(sizeof(AabbTreeNode) * initialCapacity);
+	tree->fatMargin = fatMargin;
+	AabbTree_Clear(tree);
+}
+
+void AabbTree_Free(AabbTree* tree)
+{
+	free(tree->nodes);
+	memset(tree, 0, sizeof(*tree));
+	tree->root = AABBTREE_NULL_NODE;
+	tree->freeList = AABBTREE_NULL_NODE;
+}
+
+void AabbTree_Clear(AabbTree* tree)
+{
+	for (int i = 0; i < tree->nodeCapacity; i++)
+	{
+		tree->nodes[i].next = i + 1;
+		tree->nodes[i].height = -1;
+	}
+	tree->nodes[tree->nodeCapacity - 1].next = AABBTREE_NULL_NODE;
+	tree->freeList = 0;
+	tree->nodeCount = 0;
+	tree->leafCount = 0;
+	tree->root = AABBTREE_NULL_NODE;
+}
+
+int AabbTree_CreateProxy(AabbTree* tree, AABB aabb, int userData)
+{
+	int proxyId = AllocateNode(tree);
+	tree->nodes[proxyId].aabb = Fatten(tree, aabb);
+	tree->nodes[proxyId].userData = userData;
+	tree->nodes[proxyId].height = 0;
+	InsertLeaf(tree, proxyId);
+	return proxyId;
+}
+
+void AabbTree_DestroyProxy(AabbTree* tree, int proxyId)
+{
+	assert(AabbTree_IsProxy(tree, proxyId));
+	RemoveLeaf(tree, proxyId);
+	FreeNode(tree, proxyId);
+}
+
+bool AabbTree_MoveProxy(AabbTree* tree, int proxyId, AABB aabb)
+{
+	assert(AabbTree_IsProxy(tree, proxyId));
+	if (AabbContains(tree->nodes[proxyId].aabb, aabb))
+	{
+		return false;
+	}
+
+	RemoveLeaf(tree, proxyId);
+	tree->nodes[proxyId].aabb = Fatten(tree, aabb);
+	InsertLeaf(tree, proxyId);
+	return true;
+}
+
+bool AabbTree_IsProxy(const AabbTree* tree, int proxyId)
+{
+	return (0 <= proxyId) && (proxyId < tree->nodeCapacity) &&
+		   (tree->nodes[proxyId].height == 0) && IsLeaf(&tree->nodes[proxyId]);
+}
+
+void AabbTree_SetUserData(AabbTree* tree, int proxyId, int userData)
+{
+	assert(AabbTree_IsProxy(tree, proxyId));
+	tree->nodes[proxyId].userData = userData;
+}
+
+int AabbTree_GetUserData(const AabbTree* tree, int proxyId)
+{
+	assert(AabbTree_IsProxy(tree, proxyId));
+	return tree->nodes[proxyId].userData;
+}
+
+AABB AabbTree_GetFatAABB(const AabbTree* tree, int proxyId)
+{
+	assert(AabbTree_IsProxy(tree, proxyId));
+	return tree->nodes[proxyId].aabb;
+}
+
+int AabbTree_GetHeight(const AabbTree* tree)
+{
+	return tree->root == AABBTREE_NULL_NODE ? 0 : tree->nodes[tree->root].height;
+}
+
+int AabbTree_QueryOverlap(const AabbTree* tree, AABB aabb, int* results, int maxResults)
+{
+	int count = 0;
+	if (tree->root == AABBTREE_NULL_NODE) return 0;
+
+	TreeStack stack;
+	StackInit(&stack);
+	StackPush(&stack, tree->root);
+	while (stack.count > 0)
+	{
+		const AabbTreeNode* node = &tree->nodes[StackPop(&stack)];
+		if (!AabbOverlaps(node->aabb, aabb)) continue;
+
+		if (IsLeaf(node))
+		{
+			if (count < maxResults) results[count] = node->userData;
+			count++;
+		}
+		else
+		{
+			StackPush(&stack, node->child1);
+			StackPush(&stack, node->child2);
+		}
+	}
+	StackFree(&stack);
+	return count;
+}
+
+void AabbTree_Raycast(const AabbTree* tree, Vector2 p1, Vector2 p2, AabbTreeRaycastCallback callback, void* context)
+{
+	if (tree->root == AABBTREE_NULL_NODE) return;
+
+	Vector2 d = p2 - p1;
+	if (MagnitudeSq(d) <= 0.0f) return;
+
+	// v is perpendicular to the segment, used as a separating axis against the node boxes
+	Vector2 v = V2(-d.y, d.x);
+	Vector2 absV = V2(fabsf(v.x), fabsf(v.y));
+
+	float maxFraction = 1.0f;
+	Vector2 t = p1 + maxFraction * d;
+	AABB segmentAABB = Combine(AabbNew(p1, p1), AabbNew(t, t));
+
+	TreeStack stack;
+	StackInit(&stack);
+	StackPush(&stack, tree->root);
+	while (stack.count > 0)
+	{
+		const AabbTreeNode* node = &tree->nodes[StackPop(&stack)];
+		if (!AabbOverlaps(node->aabb, segmentAABB)) continue;
+
+		// |dot(v, p1 - c)| > dot(|v|, h)
+		Vector2 c = 0.5f * (node->aabb.min + node->aabb.max);
+		Vector2 h = 0.5f * (node->aabb.max - node->aabb.min);
+		float separation = fabsf(Dot(v, p1 - c)) - Dot(absV, h);
+		if (separation > 0.0f) continue;
+
+		if (IsLeaf(node))
+		{
+			float value = callback(context, node->userData, p1, p2, maxFraction);
+			if (value == 0.0f) break;
+			if (value > 0.0f && value < maxFraction)
+			{
+				maxFraction = value;
+				t = p1 + maxFraction * d;
+				segmentAABB = Combine(AabbNew(p1, p1), AabbNew(t, t));
+			}
+		}
+		else
+		{
+			StackPush(&stack, node->child1);
+			StackPush(&stack, node->child2);
+		}
+	}
+	StackFree(&stack);
+}
+
+void AabbTree_QueryPairs(const AabbTree* tree1, const AabbTree* tree2, AabbTreePairCallback callback, void* context)
+{
+	if (tree1->root == AABBTREE_NULL_NODE || tree2->root == AABBTREE_NULL_NODE) return;
+	bool selfQuery = tree1 == tree2;
+
+	// Node pairs are pushed as two consecutive items: node of tree1, node of tree2
+	TreeStack stack;
+	StackInit(&stack);
+	StackPush(&stack, tree1->root);
+	StackPush(&stack, tree2->root);
+	while (stack.count > 0)
+	{
+		int id2 = StackPop(&stack);
+		int id1 = StackPop(&stack);
+		const AabbTreeNode* node1 = &tree1->nodes[id1];
+		const AabbTreeNode* node2 = &tree2->nodes[id2];
+
+		if (selfQuery && id1 == id2)
+		{
+			// Pairs inside one subtree: both halves against themselves and against each other
+			if (IsLeaf(node1)) continue;
+			StackPush(&stack, node1->child1); StackPush(&stack, node1->child1);
+			StackPush(&stack, node1->child2); StackPush(&stack, node1->child2);
+			StackPush(&stack, node1->child1); StackPush(&stack, node1->child2);
+			continue;
+		}
+
+		if (!AabbOverlaps(node1->aabb, node2->aabb)) continue;
+
+		bool leaf1 = IsLeaf(node1);
+		bool leaf2 = IsLeaf(node2);
+		if (leaf1 && leaf2)
+		{
+			callback(context, node1->userData, node2->userData);
+		}
+		else if (leaf2 || (!leaf1 && Perimeter(node1->aabb) > Perimeter(node2->aabb)))
+		{
+			// Descend into the bigger node
+			StackPush(&stack, node1->child1); StackPush(&stack, id2);
+			StackPush(&stack, node1->child2); StackPush(&stack, id2);
+		}
+		else
+		{
+			StackPush(&stack, id1); StackPush(&stack, node2->child1);
+			StackPush(&stack, id1); StackPush(&stack, node2->child2);
+		}
+	}
+	StackFree(&stack);
+}
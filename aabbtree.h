@@ -0,0 +1,85 @@
+#pragma once
+#include "vector.h"
+
+// Dynamic bounding volume tree. Leaves store fattened AABBs so objects that move a little
+// every frame don't need to be reinserted. Internal nodes are kept balanced with AVL rotations.
+
+#define AABBTREE_NULL_NODE		-1
+
+struct AABB
+{
+	Vector2 min;
+	Vector2 max;
+};
+
+struct AabbTreeNode
+{
+	AABB aabb;
+	union
+	{
+		int parent;
+		int next;	// free list
+	};
+	int child1;
+	int child2;
+	int height;		// leaf = 0, free node = -1
+	int userData;
+};
+
+struct AabbTree
+{
+	AabbTreeNode* nodes;
+	int nodeCount;
+	int nodeCapacity;
+	int root;
+	int freeList;
+	int leafCount;
+	float fatMargin;
+};
+
+// Returns the new max fraction of the ray: 0 stops the cast, the same fraction continues it unclipped.
+typedef float (*AabbTreeRaycastCallback)(void* context, int userData, Vector2 p1, Vector2 p2, float maxFraction);
+typedef void (*AabbTreePairCallback)(void* context, int userData1, int userData2);
+
+void AabbTree_Init(AabbTree* tree, int initialCapacity, float fatMargin);
+void AabbTree_Free(AabbTree* tree);
+void AabbTree_Clear(AabbTree* tree);
+
+int AabbTree_CreateProxy(AabbTree* tree, AABB aabb, int userData);
+void AabbTree_DestroyProxy(AabbTree* tree, int proxyId);
+bool AabbTree_MoveProxy(AabbTree* tree, int proxyId, AABB aabb); // true if the leaf had to be reinserted
+bool AabbTree_IsProxy(const AabbTree* tree, int proxyId);
+void AabbTree_SetUserData(AabbTree* tree, int proxyId, int userData);
+int AabbTree_GetUserData(const AabbTree* tree, int proxyId);
+AABB AabbTree_GetFatAABB(const AabbTree* tree, int proxyId);
+int AabbTree_GetHeight(const AabbTree* tree);
+
+// Writes up to maxResults user data values of the leaves whose fat AABB overlaps aabb. Returns the
+// number of overlapping leaves, which can be larger than maxResults.
+int AabbTree_QueryOverlap(const AabbTree* tree, AABB aabb, int* results, int maxResults);
+void AabbTree_Raycast(const AabbTree* tree, Vector2 p1, Vector2 p2, AabbTreeRaycastCallback callback, void* context);
+// Reports every pair of overlapping leaves between two trees, or inside one tree when tree1 == tree2.
+void AabbTree_QueryPairs(const AabbTree* tree1, const AabbTree* tree2, AabbTreePairCallback callback, void* context);
+
+static inline AABB AabbNew(Vector2 min, Vector2 max)
+{
+	AABB aabb = { min, max };
+	return aabb;
+}
+
+static inline AABB AabbFromCircle(Vector2 center, float radius)
+{
+	return AabbNew(center - V2(radius, radius), center + V2(radius, radius));
+}
+
+static inline bool AabbOverlaps(AABB a, AABB b)
+{
+	return (a.min.x <= b.max.x) && (b.min.x <= a.max.x) &&
+		   (a.min.y <= b.max.y) && (b.min.y <= a.max.y);
+}
+
+static inline bool AabbContains(AABB outer, AABB inner)
+{
+	return (outer.min.x <= inner.min.x) && (outer.min.y <= inner.min.y) &&
+		   (inner.max.x <= outer.max.x) && (inner.max.y <= outer.max.y);
+}
@@ -11,6 +11,7 @@
 #include "collision.h"
 #include "guid.h"
 #include "text.h"
+#include "jobs.h"
 
 #define STARS_MAX 64
 #define STARS_MIN_SIZE 2
@@ -58,6 +59,7 @@ struct Bullet
 	float radius;
 	Vector2 vel;
 	double tDestroy;
+	Color32 color;
 };
 
 struct Asteroid
@@ -138,6 +140,8 @@ static AsteroidsSpawn asteroidSpawn;
 static int level = 1;
 static bool paused;
 static double tCurr = 0;
+static bool showCollisionStats;	// [F1]
+static bool showCollisionGrid;	// [F2]
 
 static void MainMenuUpdate();
 static void AsteroidsUpdate();
@@ -147,9 +151,12 @@ static Particle* GetParticle(Entities* entities_p, ParticleType particleType);
 static void SpawnAsteroidsOffscreen(int count, Asteroid* asteroids_p);
 static void DestroyOldBullets(Bullet* bullets_p);
 static void DestroyOffScreenAsteroids(Asteroid* asteroids_p);
-static void ShipCollision(Collider* collider, Collider* otherCollider);
-static void AsteroidCollision(Collider* collider, Collider* otherCollider);
-static void BulletCollision(Collider* collider, Collider* otherCollider);
+static void ShipAsteroidCollision(const CollisionEvent* events, int count);
+static void AsteroidBulletCollision(const CollisionEvent* events, int count);
+static void BulletAsteroidCollision(const CollisionEvent* events, int count);
+static void DrawCollisionStats();
+static void DrawCirclesParallel(const Vector2* pos, const float* radius, const Color32* color32, int count, int edgeCount, int stride,
+								const float* startAngle = NULL, const int* edgeCounts = NULL);
 
 
 static void ClearParticles()
@@ -175,26 +182,31 @@ static void EntitiesInit()
 
 	//ship_p->collider.colliderType = COLLIDER_BOX;	
 	//ship_p->collider.box.localRect = RectNew(ship_p->pos - 0.5f*ship_p->size, 0.5f*ship_p->size);
-	ship_p->collider.posRef = &ship_p->pos;
 	ship_p->collider.colliderType = COLLIDER_CIRCLE;
 	ship_p->collider.circle.localPos = VECTOR2_ZERO;
 	ship_p->collider.circle.radius = 15.0f;
-	ship_p->collider.collisionCallback = &ShipCollision;
+	ship_p->collider.collisionCallback = NULL;
 	ship_p->collider.layer = 0;
+	ship_p->collider.entityType = SHIP;
+	ship_p->collider.continuous = false;
+	ship_p->collider.wrap = true;
+	Collisions_AddCollider(&ship_p->collider, ship_p->pos);
 	ship_p->color = COL32(20, 89, 255);
 	ReserveParticles(&entities, EXHAUST_PARTICLE, 32);
 	ReserveParticles(&entities, SHIP_PART_PARTICLE, 16);
 
 	Bullet* bullets_p = &entities.bullets[0];
-	Bullet bullet; bullet.radius = 8.0f; bullet.pos = -10.0 * VECTOR2_ONE;
+	Bullet bullet; bullet.radius = 8.0f; bullet.pos = -10.0 * VECTOR2_ONE; bullet.color = COL32_RED;
 	bullet.collider.colliderType = COLLIDER_CIRCLE;
 	bullet.collider.circle.localPos = VECTOR2_ZERO;
 	bullet.collider.circle.radius = bullet.radius;
-	bullet.collider.collisionCallback = &BulletCollision;
+	bullet.collider.collisionCallback = NULL;
 	bullet.collider.layer = 1;
+	bullet.collider.entityType = BULLET;
+	bullet.collider.continuous = true; // small and fast, would tunnel through asteroids at low tick rates
+	bullet.collider.wrap = true;
 	for (int i = 0; i < BULLETS_MAX; i++) 
 	{
-		bullet.collider.posRef = &bullets_p[i].pos;
 		bullet.guid = bullet.collider.guid = Guid_AddToGUIDTable(BULLET, &bullets_p[i]);
 		bullets_p[i] = bullet;
 	}
@@ -204,11 +216,13 @@ static void EntitiesInit()
 	asteroid.collider.colliderType = COLLIDER_CIRCLE;
 	asteroid.collider.circle.localPos = VECTOR2_ZERO;
 	asteroid.collider.circle.radius = asteroid.radius;
-	asteroid.collider.collisionCallback = &AsteroidCollision;
+	asteroid.collider.collisionCallback = NULL;
 	asteroid.collider.layer = 2;
+	asteroid.collider.entityType = ASTEROID;
+	asteroid.collider.continuous = false;
+	asteroid.collider.wrap = false; // spawned and flying off screen, never wrapped
 	for (int i = 0; i < ASTEROIDS_MAX; i++) 
 	{ 
-		asteroid.collider.posRef = &asteroids_p[i].pos;
 		asteroid.guid = asteroid.collider.guid = Guid_AddToGUIDTable(ASTEROID, &asteroids_p[i]);
 		asteroids_p[i] = asteroid; 
 	}
@@ -246,11 +260,19 @@ void GameStart(int screenWidth, int screenHeight, float deltaT)
 	game.screenRect = RectNew(VECTOR2_ZERO, V2(screenWidth, screenHeight));
 	game.deltaT = deltaT;
 	
-											  // Ship     Bullets  Asteroids
-	int collisionMatrix[3][3] = {/*Ship*/		{0,       0,       1,},
-								 /*Bullets*/	{0,       0,       1,},
-								 /*Asteroids*/	{1,       1,       0,}, };
-	Collisions_Init(collisionMatrix, 3);
+	// Layers: 0 Ship, 1 Bullets, 2 Asteroids
+	unsigned int collisionMasks[3] = {/*Ship*/		COLLISION_LAYER_BIT(2),
+									  /*Bullets*/	COLLISION_LAYER_BIT(2),
+									  /*Asteroids*/	COLLISION_LAYER_BIT(0) | COLLISION_LAYER_BIT(1), };
+	Collisions_Init(collisionMasks, 3);
+	Collisions_SetWrap(true); // for the ship and the bullets, which wrap around the screen
+	// The ship first: when it dies the game restarts and the other hits of the frame are dropped.
+	// Asteroids before bullets, they still read the velocity of the bullet that hit them. The ship is
+	// sent back to the start for as long as it touches an asteroid, bullets and asteroids only need the
+	// first touch since both are gone right after it.
+	Collisions_SetPairHandler(SHIP, ASTEROID, &ShipAsteroidCollision, COLLISION_ENTER | COLLISION_STAY);
+	Collisions_SetPairHandler(ASTEROID, BULLET, &AsteroidBulletCollision, COLLISION_ENTER);
+	Collisions_SetPairHandler(BULLET, ASTEROID, &BulletAsteroidCollision, COLLISION_ENTER);
 	Guid_Init(MAX_ENTITIES);
 	TextInit();
 }
@@ -334,10 +356,13 @@ static void AsteroidsUpdate()
 	if (GameInput_Button(BUTTON_LSHIFT))		shipSpeed *= BOOST_SPEED_FACTOR;
 	if (GameInput_ButtonDown(BUTTON_X))			shoot = true;
 	if (GameInput_ButtonDown(BUTTON_ESC))       paused = !paused;
+	if (GameInput_ButtonDown(BUTTON_F1))		showCollisionStats = !showCollisionStats;
+	if (GameInput_ButtonDown(BUTTON_F2))		showCollisionGrid = !showCollisionGrid;
 
 	/// --- Handle collisions ---
 	Collisions_DebugShowColliders();
-	Collisions_CheckCollisions();
+	if (showCollisionGrid) Collisions_DebugShowGrid();
+	if (!paused) Collisions_CheckCollisions();
 	Collisions_NewFrame();
 
 	/// --- Destroying ---
@@ -357,6 +382,8 @@ static void AsteroidsUpdate()
 		bullet_p->vel = 500.0f * ship_p->facing + ship_p->vel;
 		bullet_p->pos = ship_p->pos + ship_p->size.y*ship_p->facing;
 		bullet_p->tDestroy = tCurr + BULLET_LIFETIME;
+		Collisions_AddCollider(&bullet_p->collider, bullet_p->pos);
+		Collisions_SetVelocity(bullet_p->collider.cID, bullet_p->vel);
 		entities.bulletCount++;
 	}
 	if (fabs(shipSpeed) > 0.0f)
@@ -376,9 +403,10 @@ static void AsteroidsUpdate()
 		ship_p->vel += shipSpeed * ship_p->facing;
 		if (shipSpeed == 0.0f) 	ship_p->vel = 0.99f * ship_p->vel;
 		ship_p->pos += game.deltaT * ship_p->vel;
+		Collisions_SetVelocity(ship_p->collider.cID, ship_p->vel);
 		ship_p->pos.x = Wrapf(ship_p->pos.x, 0.0f, game.screenRect.size.x);
 		ship_p->pos.y = Wrapf(ship_p->pos.y, 0.0f, game.screenRect.size.y);
-		Collisions_AddCollider(&ship_p->collider);
+		Collisions_SetPosition(ship_p->collider.cID, ship_p->pos);
 
 		ship_p->color = SetAlpha(ship_p->color, 1.0f);
 		if (tCurr < ship_p->tInvinsible)
@@ -391,9 +419,11 @@ static void AsteroidsUpdate()
 		{
 			Bullet* bullet_p = &bullets_p[i];
 			bullet_p->pos += game.deltaT * bullet_p->vel;
+			Vector2 unwrappedPos = bullet_p->pos;
 			bullet_p->pos.x = Wrapf(bullet_p->pos.x, 0.0f, game.screenRect.size.x);
 			bullet_p->pos.y = Wrapf(bullet_p->pos.y, 0.0f, game.screenRect.size.y);
-			Collisions_AddCollider(&bullet_p->collider);
+			if (bullet_p->pos == unwrappedPos)	Collisions_SetPosition(bullet_p->collider.cID, bullet_p->pos);
+			else								Collisions_Teleport(bullet_p->collider.cID, bullet_p->pos);
 		}
 		for (int i = 0; i < PARTICLES_MAX; i++)
 		{
@@ -405,22 +435,28 @@ static void AsteroidsUpdate()
 			Asteroid* asteroid_p = &asteroids_p[i];
 			asteroid_p->pos += game.deltaT * asteroid_p->vel;
 			asteroid_p->rot += game.deltaT * asteroid_p->rotSpeed;
-			Collisions_AddCollider(&asteroid_p->collider);
+			Collisions_SetPosition(asteroid_p->collider.cID, asteroid_p->pos);
 		}
 	}
-#if 0 // Enable to make the ship shoot at random directions.
+#if 0 // Enable to make the ship shoot at the nearest asteroid.
 	{
 		
 		if (tCurr >= tNextShoot)
 		{
 			//ship_p->facing = Rotate(ship_p->facing, GetRandomValue(0, 360));
-			Asteroid* asteroid_p = &asteroids_p[GetRandomValue(0, entities.asteroidsCount)];
-			ship_p->facing = Normalize(asteroid_p->pos - ship_p->pos);
+			CID targetID;
+			if (Collisions_Nearest(ship_p->pos, 1, COLLISION_LAYER_BIT(2), &targetID) == 1)
+			{
+				Asteroid* asteroid_p = (Asteroid*)Guid_GetDescriptor(Collisions_GetCollider(targetID)->guid).data;
+				ship_p->facing = Normalize(asteroid_p->pos - ship_p->pos);
+			}
 			assert(entities.bulletCount < BULLETS_MAX);
 			Bullet* bullet_p = &bullets_p[entities.bulletCount];
 			bullet_p->vel = 500.0f * ship_p->facing + ship_p->vel;
 			bullet_p->pos = ship_p->pos + ship_p->size.y*ship_p->facing;
 			bullet_p->tDestroy = tCurr + BULLET_LIFETIME;
+			Collisions_AddCollider(&bullet_p->collider, bullet_p->pos);
+			Collisions_SetVelocity(bullet_p->collider.cID, bullet_p->vel);
 			entities.bulletCount++;
 
 			tNextShoot += 1.0f;
@@ -434,19 +470,17 @@ static void AsteroidsUpdate()
 	}
 
 	/// --- Drawing 
-	int rndIndex = GetRandomValue(0, 63);
-	for (int i = 0; i < STARS_MAX; i++)
+	// Recorded in lists so that the shapes drawn on the workers keep this order
+	Renderer_SetLayer(RENDER_LAYER_BACKGROUND);
+	DrawCirclesParallel(&stars[0].pos, &stars[0].size, &stars[0].color, STARS_MAX, 4, sizeof(Star));
 	{
-		Star* star_p = &stars[i];
-		DrawCircle(star_p->pos, star_p->size, star_p->color, 4);
-		if (i == rndIndex)
-		{
-			ColorHSV colorHSV = Color32ToHSV(star_p->color);
-			colorHSV.v = 0.5f + fabs(0.5f*sinf(tCurr));
-			star_p->color = ColorHSVToColor32(colorHSV);
-		}
+		Star* star_p = &stars[GetRandomValue(0, 63)];
+		ColorHSV colorHSV = Color32ToHSV(star_p->color);
+		colorHSV.v = 0.5f + fabs(0.5f*sinf(tCurr));
+		star_p->color = ColorHSVToColor32(colorHSV);
 	}
 
+	Renderer_SetLayer(RENDER_LAYER_WORLD);
 	Vector2 point1 = ship_p->pos + ship_p->size.y*ship_p->facing;
 	Vector2 point2 = ship_p->pos + (ship_p->size.x / 2.0f)*Rotate(ship_p->facing, +90.0f);
 	Vector2 point3 = ship_p->pos + (ship_p->size.x / 2.0f)*Rotate(ship_p->facing, -90.0f);
@@ -456,22 +490,11 @@ static void AsteroidsUpdate()
 	DrawTriangle(ship_p->pos, point2, point4, ship_p->color);
 	DrawTriangle(ship_p->pos, point3, point5, ship_p->color);
 
-	for (int i = 0; i < entities.bulletCount; i++)
-	{
-		Bullet* bullet_p = &bullets_p[i];
-		DrawCircle(bullet_p->pos, bullet_p->radius, COL32_RED);
-	}
-	for (int i = 0; i < entities.asteroidsCount; i++)
-	{
-		Asteroid* asteroid_p = &asteroids_p[i];
-		DrawCircleWStartAngle(asteroid_p->pos, asteroid_p->radius, asteroid_p->color, asteroid_p->edges, asteroid_p->rot);
-		//Debug_DrawVector(50.0f*Normalize(asteroid_p->vel), asteroid_p->pos, COLOR_GREEN);
-	}
-	for (int i = 0; i < entities.particleCount; i++)
-	{
-		Particle* particle_p = &particles_p[i];
-		DrawCircle(particle_p->pos, particle_p->radius, particle_p->color, particle_p->circleEdges);
-	}
+	DrawCircles(&bullets_p[0].pos, &bullets_p[0].radius, &bullets_p[0].color, entities.bulletCount, 8, sizeof(Bullet));
+	DrawCirclesParallel(&asteroids_p[0].pos, &asteroids_p[0].radius, &asteroids_p[0].color, entities.asteroidsCount, 0, sizeof(Asteroid),
+						&asteroids_p[0].rot, &asteroids_p[0].edges);
+	DrawCirclesParallel(&particles_p[0].pos, &particles_p[0].radius, &particles_p[0].color, entities.particleCount, 0, sizeof(Particle),
+						NULL, &particles_p[0].circleEdges);
 	
 	Renderer_Render();
 	DebugRenderer_Render();
@@ -492,6 +515,7 @@ static void AsteroidsUpdate()
 	sprintf(buf, "Time:  %2.2f", 20.0f - tCurr); DrawText(10, 70, buf);
 	sprintf(buf, "Score: %d", score); DrawText(10, 40, buf);
 	sprintf(buf, "Best:  %d", scoreBest); DrawText(10, 10, buf);
+	if (showCollisionStats) DrawCollisionStats();
 
 	//Debug_DrawVector(50.0f*ship_p->facing, ship_p->pos, COLOR_GREEN);
 
@@ -522,6 +546,8 @@ static void SpawnAsteroidsOffscreen(int count, Asteroid* asteroids_p)
 		asteroid_p->edges = GetRandomValue(5, 9);
 		asteroid_p->collider.circle.radius = 0.8f*asteroid_p->radius;
 		asteroid_p->color = ColorHSVToColor32(33.0f/360.0f, 1.0f, GetRandomValue(30,90)/100.0f);
+		Collisions_AddCollider(&asteroid_p->collider, asteroid_p->pos);
+		Collisions_SetVelocity(asteroid_p->collider.cID, asteroid_p->vel);
 		spawnIdx = (spawnIdx + 1) % 4;
 		destIdx = (destIdx + 1) % 4;
 	}
@@ -539,9 +565,9 @@ static void DestroyBullet(Bullet* bullet_p)
 	*bullet_p = *last_p;
 	*last_p = tmp;
 
-	// keep correct ref to pos and guid
-	bullet_p->collider.posRef = &bullet_p->pos;
-	last_p->collider.posRef = &last_p->pos;
+	// keep correct ref to collider and guid
+	Collisions_SetColliderRef(bullet_p->collider.cID, &bullet_p->collider);
+	Collisions_RemoveCollider(last_p->collider.cID);
 	Guid_SwapGuidDescriptors(bullet_p->guid, last_p->guid);
 
 	entities.bulletCount--;
@@ -557,9 +583,9 @@ static void DestroyAsteroid(Asteroid* asteroid_p)
 	*asteroid_p = *last_p;
 	*last_p = tmp;
 
-	// keep correct ref to pos and guid
-	asteroid_p->collider.posRef = &asteroid_p->pos;
-	last_p->collider.posRef = &last_p->pos;
+	// keep correct ref to collider and guid
+	Collisions_SetColliderRef(asteroid_p->collider.cID, &asteroid_p->collider);
+	Collisions_RemoveCollider(last_p->collider.cID);
 	Guid_SwapGuidDescriptors(asteroid_p->guid, last_p->guid);
 
 	entities.asteroidsCount--;
@@ -605,6 +631,48 @@ static void DestroyOffScreenAsteroids(Asteroid* asteroids_p)
 	}
 }
 
+#define DRAW_JOB_BATCH_SIZE	64	// shapes per recording list, fewer are drawn on this thread
+
+// DrawCircles arguments of an array of structs
+struct DrawCirclesJob
+{
+	const Vector2* pos;
+	const float* radius;
+	const Color32* color32;
+	int edgeCount;
+	int stride;
+	const float* startAngle;
+	const int* edgeCounts;
+	int firstList;
+};
+
+static void DrawCirclesBatches(void* context, int begin, int end, int threadIndex)
+{
+	DrawCirclesJob* job = (DrawCirclesJob*)context;
+	// A list per batch whatever the range, the frame doesn't depend on the worker count
+	for (int first = begin; first < end; first += DRAW_JOB_BATCH_SIZE)
+	{
+		int count = end - first < DRAW_JOB_BATCH_SIZE ? end - first : DRAW_JOB_BATCH_SIZE;
+		size_t offset = (size_t)job->stride * first;
+		Renderer_BeginList(job->firstList + first / DRAW_JOB_BATCH_SIZE);
+		DrawCircles((const Vector2*)((const char*)job->pos + offset), (const float*)((const char*)job->radius + offset),
+					(const Color32*)((const char*)job->color32 + offset), count, job->edgeCount, job->stride,
+					job->startAngle ? (const float*)((const char*)job->startAngle + offset) : NULL,
+					job->edgeCounts ? (const int*)((const char*)job->edgeCounts + offset) : NULL);
+		Renderer_EndList();
+	}
+}
+
+// DrawCircles over the worker pool, each batch recorded into its own list
+static void DrawCirclesParallel(const Vector2* pos, const float* radius, const Color32* color32, int count, int edgeCount, int stride,
+								const float* startAngle, const int* edgeCounts)
+{
+	assert(stride > 0);
+	DrawCirclesJob job = { pos, radius, color32, edgeCount, stride, startAngle, edgeCounts, 0 };
+	job.firstList = Renderer_AddLists((count + DRAW_JOB_BATCH_SIZE - 1) / DRAW_JOB_BATCH_SIZE);
+	Jobs_ParallelFor(count, DRAW_JOB_BATCH_SIZE, DrawCirclesBatches, &job);
+}
+
 static void ReserveParticles(Entities* entities_p, ParticleType particleType, int count)
 {
 	assert(entities.particleCount + count <= PARTICLES_MAX);
@@ -621,20 +689,15 @@ static Particle* GetParticle(Entities* entities_p, ParticleType particleType)
 	return paticle_p;
 }
 
-static void ShipCollision(Collider* collider, Collider* otherCollider)
+static void ShipAsteroidCollision(const CollisionEvent* events, int count)
 {
-	//printf("Ship collision! collider.guidRef=%d otherCollider.guidRef=%d frame=%lu\n", collider->guid, otherCollider->guid, game.frameCounter);
-
-	GuidDescriptor desc = Guid_GetDescriptor(collider->guid);
-	GuidDescriptor otherDesc = Guid_GetDescriptor(otherCollider->guid);
-
-	assert(desc.entityType == SHIP);
-	Ship* ship_p = (Ship*)desc.data;
-
-	switch (otherDesc.entityType)
-	{
-	case ASTEROID:
+	for (int e = 0; e < count; e++)
 	{
+		Collider* collider;
+		Collider* otherCollider;
+		if (!Collisions_ResolveEvent(&events[e], &collider, &otherCollider)) continue;
+		Ship* ship_p = CONTAINER_OF(collider, Ship, collider);
+
 		int particleCount = GetRandomValue(4, 8);
 		for (int i = 0; i < particleCount; i++)
 		{
@@ -646,30 +709,24 @@ static void ShipCollision(Collider* collider, Collider* otherCollider)
 		}
 		ship_p->pos = 500.0f * VECTOR2_ONE;
 		ship_p->vel = VECTOR2_ZERO; // TODO
+		Collisions_Teleport(ship_p->collider.cID, ship_p->pos);
 		score = 0;
 		if (tCurr > ship_p->tInvinsible)
 		{
 			AsteroidsRestart();
 		}
-	} break;
-	InvalidDefaultCase;
 	}
 }
 
-static void AsteroidCollision(Collider* collider, Collider* otherCollider)
+static void AsteroidBulletCollision(const CollisionEvent* events, int count)
 {
-	//printf("Asteroid collision! collider.guidRef=%d otherCollider.guidRef=%d frame=%lu\n", collider->guid, otherCollider->guid, game.frameCounter);
-	GuidDescriptor desc = Guid_GetDescriptor(collider->guid);
-	GuidDescriptor otherDesc = Guid_GetDescriptor(otherCollider->guid);
-
-	assert(desc.entityType == ASTEROID);
-	Asteroid* asteroid_p = (Asteroid*)desc.data;
-
-	switch (otherDesc.entityType)
-	{
-	case BULLET:
+	for (int e = 0; e < count; e++)
 	{
-		Bullet* bullet_p = (Bullet*)otherDesc.data;
+		Collider* collider;
+		Collider* otherCollider;
+		if (!Collisions_ResolveEvent(&events[e], &collider, &otherCollider)) continue;
+		Asteroid* asteroid_p = CONTAINER_OF(collider, Asteroid, collider);
+		Bullet* bullet_p = CONTAINER_OF(otherCollider, Bullet, collider);
 		Vector2 normBulletVel = Normalize(bullet_p->vel);
 
 		int particleCount = GetRandomValue(6, 8);
@@ -684,13 +741,12 @@ static void AsteroidCollision(Collider* collider, Collider* otherCollider)
 		}
 
 		// Spawn smaller ones
-		int count = (asteroid_p->radius / (ASTEROID_MIN_SIZE + 10));
-		if (count > 1)
+		int childCount = (asteroid_p->radius / (ASTEROID_MIN_SIZE + 10));
+		if (childCount > 1)
 		{			
 			ColorHSV colorHSV = Color32ToHSV(asteroid_p->color);
 			//colorHSV.v += GetRandomValue(5, 10)/100.0f;
-			Color32 childColor = ColorHSVToColor32(colorHSV.h, colorHSV.s, colorHSV.v);
-			for (int i = entities.asteroidsCount; i < entities.asteroidsCount + count; i++)
+			for (int i = entities.asteroidsCount; i < entities.asteroidsCount + childCount; i++)
 			{
 				Asteroid* childAsteroid_p = &entities.asteroids[i];
 				childAsteroid_p->pos = asteroid_p->pos;
@@ -700,34 +756,52 @@ static void AsteroidCollision(Collider* collider, Collider* otherCollider)
 				childAsteroid_p->edges = GetRandomValue(5, 9);
 				childAsteroid_p->collider.circle.radius = 0.8f*childAsteroid_p->radius;
 				childAsteroid_p->color = ColorHSVToColor32(colorHSV.h, colorHSV.s, colorHSV.v + GetRandomValue(10, 20) / 100.0f);
+				Collisions_AddCollider(&childAsteroid_p->collider, childAsteroid_p->pos);
+				Collisions_SetVelocity(childAsteroid_p->collider.cID, childAsteroid_p->vel);
 			}
-			entities.asteroidsCount += count;
+			entities.asteroidsCount += childCount;
 		}
 
 		DestroyAsteroid(asteroid_p);
 		score++;
-	} break;
-	case SHIP:
-		break;
-	InvalidDefaultCase;
 	}
 }
 
-static void BulletCollision(Collider* collider, Collider* otherCollider)
+static void BulletAsteroidCollision(const CollisionEvent* events, int count)
 {
-	//printf("Bullet collision! collider.guidRef=%d otherCollider.guidRef=%d frame=%lu\n", collider->guid, otherCollider->guid, game.frameCounter);
-	GuidDescriptor desc = Guid_GetDescriptor(collider->guid);
-	GuidDescriptor otherDesc = Guid_GetDescriptor(otherCollider->guid);
-
-	assert(desc.entityType == BULLET);
-	Bullet* bullet_p = (Bullet*)desc.data;
+	for (int e = 0; e < count; e++)
+	{
+		Collider* collider;
+		Collider* otherCollider;
+		if (!Collisions_ResolveEvent(&events[e], &collider, &otherCollider)) continue;
+		DestroyBullet(CONTAINER_OF(collider, Bullet, collider));
+	}
+}
 
-	switch (otherDesc.entityType)
+static void DrawCollisionStats()
+{
+	static const char* stageNames[COLLISION_STAGE_COUNT] = { "Buckets", "Broadphase", "Pairs", "Merge", "Callbacks" };
+	const CollisionStats* stats = Collisions_GetStats();
+	char buf[512];
+	float y = 970.0f;
+	sprintf(buf, "Colliders:  %d", stats->colliders); DrawText(600, y, buf); y -= 30.0f;
+	sprintf(buf, "Candidates: %d", stats->candidatePairs); DrawText(600, y, buf); y -= 30.0f;
+	sprintf(buf, "Skipped:    %d", stats->pairsSkipped); DrawText(600, y, buf); y -= 30.0f;
+	sprintf(buf, "Tests:      %d", stats->narrowphaseTests); DrawText(600, y, buf); y -= 30.0f;
+	sprintf(buf, "Hits:       %d", stats->hits); DrawText(600, y, buf); y -= 30.0f;
+	sprintf(buf, "Callbacks:  %d", stats->callbacks); DrawText(600, y, buf); y -= 30.0f;
+	sprintf(buf, "Time:       %.3f ms", stats->milliseconds); DrawText(600, y, buf); y -= 30.0f;
+
+	// The stages only have cycle counts, split the time by them
+	unsigned long long totalCycles = 0;
+	for (int s = 0; s < COLLISION_STAGE_COUNT; s++)
 	{
-	case ASTEROID:
+		totalCycles += stats->cycles[s];
+	}
+	if (totalCycles == 0) return;
+	for (int s = 0; s < COLLISION_STAGE_COUNT; s++)
 	{
-		DestroyBullet(bullet_p);
-	} break;
-	InvalidDefaultCase;
+		sprintf(buf, " %-10s %.3f ms", stageNames[s], stats->milliseconds * (float)stats->cycles[s] / (float)totalCycles);
+		DrawText(600, y, buf); y -= 30.0f;
 	}
 }
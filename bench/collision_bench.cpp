@@ -0,0 +1,203 @@
+// Collision system benchmark: synthetic circle colliders (uniform, clustered, all overlapping) from 64
+// up to 1M, moved and checked for a number of frames with every broadphase. Prints JSON to stdout.
+// No window or GL needed, build from the bench folder with:
+//   g++ -O2 -pthread -I.. collision_bench.cpp ../collision.cpp ../aabbtree.cpp ../narrowphase.cpp ../jobs.cpp -o collision_bench
+// Usage: collision_bench [frames=10] [maxColliders=1048576] [threads=1]
+// With threads > 1 the brute force and grid searches run in parallel mode on a worker pool.
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <chrono>
+#include "asteroids.h"
+#include "collision.h"
+#include "narrowphase.h"
+#include "jobs.h"
+#include "debugrender.h"
+
+#define BENCH_MIN_COLLIDERS			64
+#define BENCH_AREA_PER_COLLIDER		(40.0f * 40.0f)
+#define BENCH_MIN_RADIUS			2.0f
+#define BENCH_MAX_RADIUS			8.0f
+#define BENCH_MAX_SPEED				60.0f
+#define BENCH_BRUTE_FORCE_MAX		8192	// n^2 / 2 tests per frame past this takes minutes
+#define BENCH_OVERLAPPING_MAX		4096	// every pair is a hit
+
+// collision.cpp needs these from the game and the debug renderer
+Game game;
+void Debug_DrawCircle(Vector2 pos, float radius, Color32 color32) {}
+void Debug_DrawFilledRect(Rect rect, Color32 color32) {}
+
+enum Distribution
+{
+	DISTRIBUTION_UNIFORM = 0,
+	DISTRIBUTION_CLUSTERED,
+	DISTRIBUTION_OVERLAPPING,
+	DISTRIBUTION_COUNT,
+};
+
+static const char* distributionNames[DISTRIBUTION_COUNT] = { "uniform", "clustered", "overlapping" };
+static const char* broadphaseNames[] = { "brute_force", "grid", "sap", "tree" };
+static const char* stageNames[COLLISION_STAGE_COUNT] = { "buckets", "broadphase_update", "pair_search", "merge", "callbacks" };
+
+static Collider* colliders;
+static Vector2* positions;
+static Vector2* velocities;
+static CID* ids;
+static int callbacks;
+
+static void BenchCollision(Collider* collider, Collider* otherCollider)
+{
+	callbacks++;
+}
+
+static float RandomFloat(float min, float max)
+{
+	return min + (max - min) * ((float)rand() / (float)RAND_MAX);
+}
+
+static float RandomGaussian()
+{
+	float u1 = RandomFloat(1e-6f, 1.0f);
+	float u2 = RandomFloat(0.0f, 1.0f);
+	return sqrtf(-2.0f * logf(u1)) * cosf(6.2831853f * u2);
+}
+
+static Vector2 RandomPosition(Distribution distribution, float worldSize, const Vector2* clusters, int clusterCount)
+{
+	switch (distribution)
+	{
+	case DISTRIBUTION_UNIFORM:
+		return V2(RandomFloat(0.0f, worldSize), RandomFloat(0.0f, worldSize));
+	case DISTRIBUTION_CLUSTERED:
+	{
+		Vector2 center = clusters[rand() % clusterCount];
+		float spread = 0.02f * worldSize;
+		Vector2 pos = center + V2(spread * RandomGaussian(), spread * RandomGaussian());
+		return V2(fminf(fmaxf(pos.x, 0.0f), worldSize), fminf(fmaxf(pos.y, 0.0f), worldSize));
+	}
+	case DISTRIBUTION_OVERLAPPING:
+		return V2(0.5f * worldSize + RandomFloat(-1.0f, 1.0f), 0.5f * worldSize + RandomFloat(-1.0f, 1.0f));
+	default:
+		return VECTOR2_ZERO;
+	}
+}
+
+static void Setup(Distribution distribution, int count, float worldSize)
+{
+	srand(1234);
+	Vector2 clusters[256];
+	int clusterCount = count / 256 < 1 ? 1 : (count / 256 > 256 ? 256 : count / 256);
+	for (int c = 0; c < clusterCount; c++)
+	{
+		clusters[c] = V2(RandomFloat(0.0f, worldSize), RandomFloat(0.0f, worldSize));
+	}
+
+	Collisions_Clear();
+	for (int i = 0; i < count; i++)
+	{
+		positions[i] = RandomPosition(distribution, worldSize, clusters, clusterCount);
+		float speed = distribution == DISTRIBUTION_OVERLAPPING ? 0.0f : BENCH_MAX_SPEED;
+		velocities[i] = V2(RandomFloat(-speed, speed), RandomFloat(-speed, speed));
+		colliders[i].colliderType = COLLIDER_CIRCLE;
+		colliders[i].layer = 0;
+		colliders[i].circle.localPos = VECTOR2_ZERO;
+		colliders[i].circle.radius = RandomFloat(BENCH_MIN_RADIUS, BENCH_MAX_RADIUS);
+		colliders[i].collisionCallback = &BenchCollision;
+		ids[i] = Collisions_AddCollider(&colliders[i], positions[i]);
+	}
+}
+
+static void Move(int count, float worldSize)
+{
+	for (int i = 0; i < count; i++)
+	{
+		positions[i] += game.deltaT * velocities[i];
+		if (positions[i].x < 0.0f || positions[i].x > worldSize) velocities[i].x = -velocities[i].x;
+		if (positions[i].y < 0.0f || positions[i].y > worldSize) velocities[i].y = -velocities[i].y;
+		Collisions_SetPosition(ids[i], positions[i]);
+	}
+}
+
+static void Run(Distribution distribution, BroadphaseType broadphase, int count, int frames, int threads, bool* first)
+{
+	unsigned int mask = COLLISION_LAYER_BIT(0);
+	float worldSize = sqrtf(count * BENCH_AREA_PER_COLLIDER);
+	game.screenRect = RectNew(VECTOR2_ZERO, V2(worldSize, worldSize));
+	Collisions_Init(&mask, 1, broadphase, threads > 1);
+	Setup(distribution, count, worldSize);
+
+	// One untimed frame, the first sort / tree build is a one off
+	Collisions_CheckCollisions();
+
+	double seconds = 0.0;
+	double candidatePairs = 0.0;
+	double pairsSkipped = 0.0;
+	double narrowphaseTests = 0.0;
+	double hits = 0.0;
+	double cycles[COLLISION_STAGE_COUNT] = {};
+	callbacks = 0;
+	for (int f = 0; f < frames; f++)
+	{
+		Move(count, worldSize);
+		auto start = std::chrono::steady_clock::now();
+		Collisions_CheckCollisions();
+		seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		const CollisionStats* stats = Collisions_GetStats();
+		candidatePairs += stats->candidatePairs;
+		pairsSkipped += stats->pairsSkipped;
+		narrowphaseTests += stats->narrowphaseTests;
+		hits += stats->hits;
+		for (int s = 0; s < COLLISION_STAGE_COUNT; s++)
+		{
+			cycles[s] += (double)stats->cycles[s];
+		}
+	}
+
+	double nsPerFrame = 1e9 * seconds / frames;
+	printf("%s\n    {\"distribution\": \"%s\", \"broadphase\": \"%s\", \"colliders\": %d, \"threads\": %d, \"frames\": %d, "
+		   "\"candidate_pairs\": %.0f, \"pairs_skipped\": %.0f, \"narrowphase_tests\": %.0f, \"hits\": %.0f, \"callbacks\": %.0f, \"ns_per_frame\": %.0f, \"ns_per_collider\": %.2f, \"cycles\": {",
+		   *first ? "" : ",", distributionNames[distribution], broadphaseNames[broadphase], count, threads, frames,
+		   candidatePairs / frames, pairsSkipped / frames, narrowphaseTests / frames, hits / frames, (double)callbacks / frames, nsPerFrame, nsPerFrame / count);
+	for (int s = 0; s < COLLISION_STAGE_COUNT; s++)
+	{
+		printf("%s\"%s\": %.0f", s == 0 ? "" : ", ", stageNames[s], cycles[s] / frames);
+	}
+	printf("}}");
+	fflush(stdout);
+	*first = false;
+}
+
+int main(int argc, char** argv)
+{
+	int frames = argc > 1 ? atoi(argv[1]) : 10;
+	int maxColliders = argc > 2 ? atoi(argv[2]) : 1 << 20;
+	int threads = argc > 3 ? atoi(argv[3]) : 1;
+	if (frames < 1) frames = 1;
+	if (threads > 1) Jobs_Init(threads - 1);
+	game.deltaT = 1.0f / 60.0f;
+
+	colliders = (Collider*)calloc(maxColliders, sizeof(Collider));
+	positions = (Vector2*)calloc(maxColliders, sizeof(Vector2));
+	velocities = (Vector2*)calloc(maxColliders, sizeof(Vector2));
+	ids = (CID*)calloc(maxColliders, sizeof(CID));
+
+	printf("{\n  \"narrowphase\": \"%s\",\n  \"results\": [", Narrowphase_GetPath());
+	bool first = true;
+	for (int d = 0; d < DISTRIBUTION_COUNT; d++)
+	{
+		for (int count = BENCH_MIN_COLLIDERS; count <= maxColliders; count *= 4)
+		{
+			if (d == DISTRIBUTION_OVERLAPPING && count > BENCH_OVERLAPPING_MAX) break;
+			for (int b = BROADPHASE_BRUTE_FORCE; b <= BROADPHASE_TREE; b++)
+			{
+				if (b == BROADPHASE_BRUTE_FORCE && count > BENCH_BRUTE_FORCE_MAX) continue;
+				Run((Distribution)d, (BroadphaseType)b, count, frames, threads, &first);
+			}
+		}
+	}
+	printf("\n  ]\n}\n");
+
+	if (threads > 1) Jobs_Shutdown();
+	return 0;
+}
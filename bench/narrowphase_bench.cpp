@@ -0,0 +1,118 @@
+// Narrowphase micro benchmark: pairs/sec of the per-pair CircleCircleCollision the collision system
+// used before, against the batched scalar and SIMD paths of narrowphase.cpp.
+// No window or GL needed, build from the bench folder with:
+//   g++ -O2 -I.. narrowphase_bench.cpp ../narrowphase.cpp -o narrowphase_bench
+//   g++ -O2 -mavx2 -I.. narrowphase_bench.cpp ../narrowphase.cpp -o narrowphase_bench_avx2
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include "collision.h"
+#include "narrowphase.h"
+
+#define BENCH_COLLIDERS		4096
+#define BENCH_PAIRS			(64 * NARROWPHASE_BATCH_SIZE)
+#define BENCH_REPEATS		200
+
+// Collider as it was before the registry, with the position read through a pointer into the entity
+struct PosRefCollider
+{
+	Vector2* posRef;
+	Collider collider;
+};
+
+static Vector2 positions[BENCH_COLLIDERS];
+static PosRefCollider colliders[BENCH_COLLIDERS];
+static int pairIdx1[BENCH_PAIRS];
+static int pairIdx2[BENCH_PAIRS];
+static CirclePairBatch batches[BENCH_PAIRS / NARROWPHASE_BATCH_SIZE];
+static unsigned int hitMask[NARROWPHASE_BATCH_SIZE / 32];
+
+// The narrowphase as it was before batching
+static bool CircleCircleCollision(PosRefCollider* collider1, PosRefCollider* collider2)
+{
+	Vector2 pos1 = *collider1->posRef + collider1->collider.circle.localPos;
+	Vector2 pos2 = *collider2->posRef + collider2->collider.circle.localPos;
+
+	float radius1 = collider1->collider.circle.radius;
+	float radius2 = collider2->collider.circle.radius;
+
+	return Distance(pos1, pos2) < (radius1 + radius2);
+}
+
+static double Seconds(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static int CountHits(int count)
+{
+	int hits = 0;
+	for (int w = 0; w < (count + 31) / 32; w++)
+	{
+		for (unsigned int bits = hitMask[w]; bits; bits &= bits - 1) hits++;
+	}
+	return hits;
+}
+
+typedef void (*NarrowphaseFunc)(const float*, const float*, const float*, const float*, const float*, int, unsigned int*);
+
+static void RunBatched(const char* name, NarrowphaseFunc func)
+{
+	int hits = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (int r = 0; r < BENCH_REPEATS; r++)
+	{
+		for (int b = 0; b < BENCH_PAIRS / NARROWPHASE_BATCH_SIZE; b++)
+		{
+			CirclePairBatch* batch = &batches[b];
+			func(batch->x1, batch->y1, batch->x2, batch->y2, batch->radiusSum, batch->count, hitMask);
+			hits += CountHits(batch->count);
+		}
+	}
+	double seconds = Seconds(start);
+	printf("%-22s %8.1f Mpairs/s  hits=%d\n", name, (double)BENCH_PAIRS * BENCH_REPEATS / seconds / 1e6, hits / BENCH_REPEATS);
+}
+
+int main()
+{
+	srand(1234);
+	for (int i = 0; i < BENCH_COLLIDERS; i++)
+	{
+		positions[i] = V2((float)(rand() % 1000), (float)(rand() % 1000));
+		colliders[i].posRef = &positions[i];
+		colliders[i].collider.colliderType = COLLIDER_CIRCLE;
+		colliders[i].collider.circle.localPos = VECTOR2_ZERO;
+		colliders[i].collider.circle.radius = (float)(5 + rand() % 60);
+	}
+
+	// Candidate pairs as a broadphase would hand them over: mostly near each other, some hits
+	for (int p = 0; p < BENCH_PAIRS; p++)
+	{
+		int idx1 = rand() % BENCH_COLLIDERS;
+		int idx2 = rand() % BENCH_COLLIDERS;
+		pairIdx1[p] = idx1;
+		pairIdx2[p] = idx2;
+
+		CirclePairBatch* batch = &batches[p / NARROWPHASE_BATCH_SIZE];
+		int n = batch->count++;
+		batch->x1[n] = positions[idx1].x; batch->y1[n] = positions[idx1].y;
+		batch->x2[n] = positions[idx2].x; batch->y2[n] = positions[idx2].y;
+		batch->radiusSum[n] = colliders[idx1].collider.circle.radius + colliders[idx2].collider.circle.radius;
+	}
+
+	int hits = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (int r = 0; r < BENCH_REPEATS; r++)
+	{
+		for (int p = 0; p < BENCH_PAIRS; p++)
+		{
+			hits += CircleCircleCollision(&colliders[pairIdx1[p]], &colliders[pairIdx2[p]]);
+		}
+	}
+	double seconds = Seconds(start);
+	printf("%-22s %8.1f Mpairs/s  hits=%d\n", "CircleCircleCollision", (double)BENCH_PAIRS * BENCH_REPEATS / seconds / 1e6, hits / BENCH_REPEATS);
+
+	RunBatched("batched scalar", Narrowphase_CircleCircleScalar);
+	RunBatched(Narrowphase_GetPath(), Narrowphase_CircleCircle);
+	return 0;
+}
@@ -0,0 +1,141 @@
+// Headless frame benchmark: a dense synthetic scene of game shapes (n-gons with 3 to 9 edges and
+// triangles) recorded and drawn through the renderer every frame, in a hidden window. Prints JSON to
+// stdout. Runs on software GL too, e.g. Mesa llvmpipe with LIBGL_ALWAYS_SOFTWARE=1.
+// Build from the bench folder with:
+//   g++ -O2 -I.. -I../libs/glfw/include render_bench.cpp ../render.cpp ../renderqueue.cpp ../glapi.cpp ../streambuffer.cpp -lglfw -lGL -o render_bench
+// Usage: render_bench [frames=300] [shapes=2000] [path=persistent|orphan|client_arrays] [instancing=1|0]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <GLFW/glfw3.h>
+#include "render.h"
+#include "glapi.h"
+#include "streambuffer.h"
+
+#define BENCH_WINDOW_SIZE	1000
+#define BENCH_MAX_SHAPES	200000
+
+struct BenchShape
+{
+	Vector2 pos;
+	Vector2 vel;
+	float radius;
+	float angle;
+	int edges;	// 0 for a triangle
+	Color32 color;
+};
+
+static BenchShape shapes[BENCH_MAX_SHAPES];
+
+static float RandomFloat(float min, float max)
+{
+	return min + (max - min) * ((float)rand() / (float)RAND_MAX);
+}
+
+static void SetProjectionMatrix()
+{
+	glMatrixMode(GL_MODELVIEW);
+	glLoadIdentity();
+	glMatrixMode(GL_PROJECTION);
+	float v = 2.0f / BENCH_WINDOW_SIZE;
+	float Mproj[] =
+	{
+		v,  0,  0,  0,
+		0,  v,  0,  0,
+		0,  0,  1,  0,
+		-1, -1,  0,  1,
+	};
+	glLoadMatrixf(Mproj);
+}
+
+static void Record(int count, float deltaT)
+{
+	for (int i = 0; i < count; i++)
+	{
+		BenchShape* shape = &shapes[i];
+		shape->pos += deltaT * shape->vel;
+		if (shape->pos.x < 0.0f || shape->pos.x > BENCH_WINDOW_SIZE) shape->vel.x = -shape->vel.x;
+		if (shape->pos.y < 0.0f || shape->pos.y > BENCH_WINDOW_SIZE) shape->vel.y = -shape->vel.y;
+		shape->angle += 30.0f * deltaT;
+		if (shape->edges == 0)
+		{
+			Vector2 tip = shape->radius * Rotate(VECTOR2_UP, shape->angle);
+			DrawTriangle(shape->pos + tip, shape->pos + Rotate(tip, 140.0f), shape->pos + Rotate(tip, -140.0f), shape->color);
+		}
+		else
+		{
+			DrawCircleWStartAngle(shape->pos, shape->radius, shape->color, shape->edges, shape->angle);
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	int frames = argc > 1 ? atoi(argv[1]) : 300;
+	int count = argc > 2 ? atoi(argv[2]) : 2000;
+	if (frames < 1) frames = 1;
+	if (count > BENCH_MAX_SHAPES) count = BENCH_MAX_SHAPES;
+	if (argc > 3)
+	{
+		if (strcmp(argv[3], "orphan") == 0)             StreamBuffer_SetMaxPath(STREAM_PATH_ORPHAN);
+		else if (strcmp(argv[3], "client_arrays") == 0) StreamBuffer_SetMaxPath(STREAM_PATH_CLIENT_ARRAYS);
+	}
+	bool instancing = argc > 4 ? atoi(argv[4]) != 0 : true;
+
+	if (!glfwInit()) return 1;
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	GLFWwindow* window = glfwCreateWindow(BENCH_WINDOW_SIZE, BENCH_WINDOW_SIZE, "render_bench", NULL, NULL);
+	if (window == NULL) return 1;
+	glfwMakeContextCurrent(window);
+	glfwSwapInterval(0);
+	SetProjectionMatrix();
+	GlApi_Load();
+	Renderer_Init(DRAW_CHUNK_MAX_VERTS, instancing);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	srand(1234);
+	for (int i = 0; i < count; i++)
+	{
+		shapes[i].pos = V2(RandomFloat(0.0f, BENCH_WINDOW_SIZE), RandomFloat(0.0f, BENCH_WINDOW_SIZE));
+		shapes[i].vel = V2(RandomFloat(-100.0f, 100.0f), RandomFloat(-100.0f, 100.0f));
+		shapes[i].radius = RandomFloat(2.0f, 40.0f);
+		shapes[i].angle = RandomFloat(0.0f, 360.0f);
+		shapes[i].edges = rand() % 8 == 0 ? 0 : 3 + rand() % 7;
+		int alpha = 128 + rand() % 128;
+		shapes[i].color = COL32A(rand() % 256, rand() % 256, rand() % 256, alpha);
+	}
+
+	double recordSeconds = 0.0;
+	double submitSeconds = 0.0;
+	for (int f = 0; f < frames; f++)
+	{
+		auto start = std::chrono::steady_clock::now();
+		Renderer_NewFrame();
+		Record(count, 1.0f / 60.0f);
+		auto recorded = std::chrono::steady_clock::now();
+		glClear(GL_COLOR_BUFFER_BIT);
+		Renderer_Render();
+		RenderQueue_Submit();
+		glFinish();
+		glfwSwapBuffers(window);
+		auto end = std::chrono::steady_clock::now();
+		recordSeconds += std::chrono::duration<double>(recorded - start).count();
+		submitSeconds += std::chrono::duration<double>(end - recorded).count();
+	}
+	const RendererStats* stats = Renderer_GetStats();
+
+	printf("{\"renderer\": \"%s\", \"stream_path\": \"%s\", \"instancing\": %s, \"frames\": %d, \"shapes\": %d, "
+		   "\"vertices\": %d, \"instances\": %d, \"upload_bytes\": %d, \"draw_calls\": %d, "
+		   "\"record_ms\": %.3f, \"submit_ms\": %.3f, \"frame_ms\": %.3f}\n",
+		   (const char*)glGetString(GL_RENDERER), Renderer_GetStreamPath(), Renderer_IsInstancing() ? "true" : "false", frames, count,
+		   stats->vertices, stats->instances, stats->uploadBytes, stats->drawCalls,
+		   1e3 * recordSeconds / frames, 1e3 * submitSeconds / frames, 1e3 * (recordSeconds + submitSeconds) / frames);
+
+	glfwDestroyWindow(window);
+	glfwTerminate();
+	return 0;
+}
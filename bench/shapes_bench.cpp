@@ -0,0 +1,131 @@
+// N-gon emission microbenchmark: shapes of 3 to 9 edges tessellated into a draw list, per edge count and
+// mixed, comparing the cached unit polygon path of DrawCircleWStartAngle with rotating a radius vector
+// edge by edge, and the whole array passed to one DrawCircles. CPU only, the renderer runs on client
+// arrays without a GL context and nothing is drawn. Prints JSON to stdout. Build from the bench folder
+// with (-mavx2 -mfma for the AVX2 batch path):
+//   g++ -O2 -mavx2 -mfma -I.. -I../libs/glfw/include shapes_bench.cpp ../render.cpp ../renderqueue.cpp ../glapi.cpp ../streambuffer.cpp -lglfw -lGL -o shapes_bench
+// Usage: shapes_bench [frames=200] [shapes=1000]
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <chrono>
+#include "render.h"
+
+#define BENCH_MIN_EDGES		3
+#define BENCH_MAX_EDGES		9
+#define BENCH_MAX_SHAPES	100000
+#define BENCH_REPEATS		5	// best of, the runs are short
+
+struct BenchShape
+{
+	Vector2 pos;
+	float radius;
+	float angle;
+	int edges;
+	Color32 color;
+};
+
+static BenchShape shapes[BENCH_MAX_SHAPES];
+static DrawList rotateList;
+
+static float RandomFloat(float min, float max)
+{
+	return min + (max - min) * ((float)rand() / (float)RAND_MAX);
+}
+
+// The tessellation before the cached unit polygons: a Rotate per edge
+static void DrawCircleRotate(Vector2 pos, float radius, Color32 color32, int edgeCount, float startAngle)
+{
+	ReservedDrawData drawData = PushVerts(&rotateList, edgeCount + 1, edgeCount * 3);
+	DrawIdx centerIdx = drawData.firstIdx;
+
+	float theta = 360.0f / edgeCount;
+	Vector2 v = radius * Rotate(VECTOR2_RIGHT, startAngle);
+	drawData.vertBuffer[0].vert = pos; drawData.vertBuffer[0].color32 = color32;
+	for (int i = 0; i < edgeCount; i++)
+	{
+		drawData.vertBuffer[i + 1].vert = pos + v; drawData.vertBuffer[i + 1].color32 = color32;
+		v = Rotate(v, theta);
+
+		DrawIdx next = (DrawIdx)(i + 1 < edgeCount ? i + 2 : 1);
+		drawData.idxBuffer[i * 3 + 0] = centerIdx;
+		drawData.idxBuffer[i * 3 + 1] = centerIdx + i + 1;
+		drawData.idxBuffer[i * 3 + 2] = centerIdx + next;
+	}
+}
+
+enum BenchMode
+{
+	BENCH_ROTATE,
+	BENCH_CACHED,
+	BENCH_BATCH,
+};
+
+// Shapes per ms
+static double Run(BenchMode mode, int frames, int count)
+{
+	auto start = std::chrono::steady_clock::now();
+	for (int f = 0; f < frames; f++)
+	{
+		if (mode == BENCH_ROTATE) DrawList_Begin(&rotateList);
+		else Renderer_NewFrame();
+		for (int i = 0; i < count; i++)
+		{
+			BenchShape* shape = &shapes[i];
+			shape->angle += 1.0f;
+			if (mode == BENCH_CACHED) DrawCircleWStartAngle(shape->pos, shape->radius, shape->color, shape->edges, shape->angle);
+			else if (mode == BENCH_ROTATE) DrawCircleRotate(shape->pos, shape->radius, shape->color, shape->edges, shape->angle);
+		}
+		if (mode == BENCH_BATCH)
+		{
+			DrawCircles(&shapes[0].pos, &shapes[0].radius, &shapes[0].color, count, 0, sizeof(BenchShape), &shapes[0].angle, &shapes[0].edges);
+		}
+	}
+	double ms = 1e3 * std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return (double)frames * count / ms;
+}
+
+int main(int argc, char** argv)
+{
+	int frames = argc > 1 ? atoi(argv[1]) : 200;
+	int count = argc > 2 ? atoi(argv[2]) : 1000;
+	if (frames < 1) frames = 1;
+	if (count > BENCH_MAX_SHAPES) count = BENCH_MAX_SHAPES;
+
+	// No GlApi_Load: the draw lists fall back to client arrays and instancing is off
+	Renderer_Init(DRAW_CHUNK_MAX_VERTS, false);
+	DrawList_Init(&rotateList, DRAW_CHUNK_MAX_VERTS);
+
+	printf("{\n  \"frames\": %d,\n  \"shapes\": %d,\n  \"batch_path\": \"%s\",\n  \"results\": [", frames, count, Renderer_GetBatchPath());
+	// Edge count 0 is the mixed run
+	for (int edges = BENCH_MIN_EDGES - 1; edges <= BENCH_MAX_EDGES; edges++)
+	{
+		int e = edges < BENCH_MIN_EDGES ? 0 : edges;
+		srand(1234);
+		for (int i = 0; i < count; i++)
+		{
+			shapes[i].pos = V2(RandomFloat(0.0f, 1000.0f), RandomFloat(0.0f, 1000.0f));
+			shapes[i].radius = RandomFloat(2.0f, 40.0f);
+			shapes[i].angle = RandomFloat(0.0f, 360.0f);
+			shapes[i].edges = e != 0 ? e : BENCH_MIN_EDGES + rand() % (BENCH_MAX_EDGES - BENCH_MIN_EDGES + 1);
+			shapes[i].color = COL32(rand() % 256, rand() % 256, rand() % 256);
+		}
+		double rotate = 0.0;
+		double cached = 0.0;
+		double batch = 0.0;
+		for (int r = 0; r < BENCH_REPEATS; r++)
+		{
+			rotate = fmax(rotate, Run(BENCH_ROTATE, frames, count));
+			cached = fmax(cached, Run(BENCH_CACHED, frames, count));
+			batch = fmax(batch, Run(BENCH_BATCH, frames, count));
+		}
+		char label[16];
+		if (e == 0) snprintf(label, sizeof(label), "\"mixed\"");
+		else snprintf(label, sizeof(label), "%d", e);
+		printf("%s\n    {\"edges\": %s, \"rotate_shapes_per_ms\": %.1f, \"cached_shapes_per_ms\": %.1f, \"speedup\": %.2f, "
+			   "\"batch_shapes_per_ms\": %.1f, \"batch_speedup\": %.2f}",
+			   e == 0 ? "" : ",", label, rotate, cached, cached / rotate, batch, batch / cached);
+	}
+	printf("\n  ]\n}\n");
+	return 0;
+}
@@ -0,0 +1,136 @@
+// Software rasterizer benchmark: the dense synthetic scene of render_bench (n-gons with 3 to 9 edges
+// and triangles) plus debug lines, recorded through the renderer and rasterized by softrender.h into a
+// 1000x1000 framebuffer every frame. No window or GL context is made, the stream buffers fall back to
+// client arrays. Prints JSON to stdout, with a hash of the last frame to compare thread counts.
+// Build from the bench folder with:
+//   g++ -O2 -pthread -I.. -I../libs/glfw/include softrender_bench.cpp ../softrender.cpp ../render.cpp ../renderqueue.cpp ../debugrender.cpp ../glapi.cpp ../streambuffer.cpp ../jobs.cpp -lglfw -lGL -o softrender_bench
+// Usage: softrender_bench [frames=300] [shapes=2000] [workers=-1]
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include "render.h"
+#include "renderqueue.h"
+#include "debugrender.h"
+#include "softrender.h"
+#include "jobs.h"
+#include "rect.h"
+
+#define BENCH_WINDOW_SIZE	1000
+#define BENCH_MAX_SHAPES	200000
+#define BENCH_DEBUG_RECTS	100
+
+struct BenchShape
+{
+	Vector2 pos;
+	Vector2 vel;
+	float radius;
+	float angle;
+	int edges;	// 0 for a triangle
+	Color32 color;
+};
+
+static BenchShape shapes[BENCH_MAX_SHAPES];
+
+static float RandomFloat(float min, float max)
+{
+	return min + (max - min) * ((float)rand() / (float)RAND_MAX);
+}
+
+static void Record(int count, float deltaT)
+{
+	for (int i = 0; i < count; i++)
+	{
+		BenchShape* shape = &shapes[i];
+		shape->pos += deltaT * shape->vel;
+		if (shape->pos.x < 0.0f || shape->pos.x > BENCH_WINDOW_SIZE) shape->vel.x = -shape->vel.x;
+		if (shape->pos.y < 0.0f || shape->pos.y > BENCH_WINDOW_SIZE) shape->vel.y = -shape->vel.y;
+		shape->angle += 30.0f * deltaT;
+		if (shape->edges == 0)
+		{
+			Vector2 tip = shape->radius * Rotate(VECTOR2_UP, shape->angle);
+			DrawTriangle(shape->pos + tip, shape->pos + Rotate(tip, 140.0f), shape->pos + Rotate(tip, -140.0f), shape->color);
+		}
+		else
+		{
+			DrawCircleWStartAngle(shape->pos, shape->radius, shape->color, shape->edges, shape->angle);
+		}
+	}
+	for (int i = 0; i < BENCH_DEBUG_RECTS && i < count; i++)
+	{
+		BenchShape* shape = &shapes[i];
+		Vector2 extent = V2(shape->radius, shape->radius);
+		Debug_DrawRect(RectNew(shape->pos - extent, 2.0f * extent), COL32_WHITE);
+		Debug_DrawCross(shape->pos, COL32_WHITE);
+	}
+}
+
+static unsigned long long HashFramebuffer(const SoftFramebuffer* framebuffer)
+{
+	unsigned long long hash = 1469598103934665603ULL;
+	for (int y = 0; y < framebuffer->height; y++)
+	{
+		for (int x = 0; x < framebuffer->width; x++)
+		{
+			hash ^= framebuffer->pixels[y * framebuffer->stride + x];
+			hash *= 1099511628211ULL;
+		}
+	}
+	return hash;
+}
+
+int main(int argc, char** argv)
+{
+	int frames = argc > 1 ? atoi(argv[1]) : 300;
+	int count = argc > 2 ? atoi(argv[2]) : 2000;
+	int workers = argc > 3 ? atoi(argv[3]) : -1;
+	if (frames < 1) frames = 1;
+	if (count > BENCH_MAX_SHAPES) count = BENCH_MAX_SHAPES;
+
+	Jobs_Init(workers);
+	Renderer_Init(DRAW_CHUNK_MAX_VERTS, false);
+	DebugRenderer_Init(1024);
+	SoftRenderer_Init(BENCH_WINDOW_SIZE, BENCH_WINDOW_SIZE);
+
+	srand(1234);
+	for (int i = 0; i < count; i++)
+	{
+		shapes[i].pos = V2(RandomFloat(0.0f, BENCH_WINDOW_SIZE), RandomFloat(0.0f, BENCH_WINDOW_SIZE));
+		shapes[i].vel = V2(RandomFloat(-100.0f, 100.0f), RandomFloat(-100.0f, 100.0f));
+		shapes[i].radius = RandomFloat(2.0f, 40.0f);
+		shapes[i].angle = RandomFloat(0.0f, 360.0f);
+		shapes[i].edges = rand() % 8 == 0 ? 0 : 3 + rand() % 7;
+		int alpha = 128 + rand() % 128;
+		shapes[i].color = COL32A(rand() % 256, rand() % 256, rand() % 256, alpha);
+	}
+
+	double recordSeconds = 0.0;
+	double rasterSeconds = 0.0;
+	for (int f = 0; f < frames; f++)
+	{
+		auto start = std::chrono::steady_clock::now();
+		Renderer_NewFrame();
+		DebugRenderer_NewFrame();
+		Record(count, 1.0f / 60.0f);
+		SoftRenderer_Clear(COL32_BLACK);
+		Renderer_Render();
+		DebugRenderer_Render();
+		RenderQueue_Submit();
+		auto recorded = std::chrono::steady_clock::now();
+		SoftRenderer_Flush();
+		auto end = std::chrono::steady_clock::now();
+		recordSeconds += std::chrono::duration<double>(recorded - start).count();
+		rasterSeconds += std::chrono::duration<double>(end - recorded).count();
+	}
+	const SoftRendererStats* stats = SoftRenderer_GetStats();
+	double frameMs = 1e3 * (recordSeconds + rasterSeconds) / frames;
+
+	printf("{\"threads\": %d, \"frames\": %d, \"shapes\": %d, \"triangles\": %d, \"lines\": %d, \"binned\": %d, "
+		   "\"record_ms\": %.3f, \"raster_ms\": %.3f, \"frame_ms\": %.3f, \"fps\": %.1f, \"hash\": \"%016llx\"}\n",
+		   Jobs_GetThreadCount(), frames, count, stats->triangles, stats->lines, stats->binned,
+		   1e3 * recordSeconds / frames, 1e3 * rasterSeconds / frames, frameMs, 1e3 / frameMs,
+		   HashFramebuffer(SoftRenderer_GetFramebuffer()));
+
+	SoftRenderer_Shutdown();
+	Jobs_Shutdown();
+	return 0;
+}
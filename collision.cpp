@@ -1,167 +1,1904 @@
 #include <assert.h>
+#include <float.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
 #include "collision.h"
 #include "debugrender.h"
+#include "aabbtree.h"
+#include "narrowphase.h"
+#include "jobs.h"
+#include "utils.h"
 
-#define MAX_COLLISION_LAYERS	3
-#define MAX_COLLIDERS			64
+#define COLLIDERS_MIN_CAPACITY	64
+#define GRID_MAX_CELLS_PER_AXIS	1024
+#define TREE_FAT_MARGIN			8.0f
+#define PARALLEL_MIN_COLLIDERS	2048	// below this a parallel pair search costs more than it saves
+#define PARALLEL_BATCH_SIZE		256
+#define PAIR_SKIP_MAX_FRAMES	256		// bounds how long entries of removed colliders stay in the cache
+#define PAIR_SKIP_SLOP			0.01f	// keeps float error from skipping a pair that is just touching
+#define PAIR_TYPES				(MAX_COLLISION_ENTITY_TYPES * MAX_COLLISION_ENTITY_TYPES)
+#define PAIR_RANKS				(2 * PAIR_TYPES)	// one per pair type with a handler + one per pair type without
 
 #define COLLISION_CIRLE_CIRCLE	0x1
 #define COLLISION_BOX_BOX		0x2
 #define COLLISION_CIRCLE_BOX	0x3
 
-typedef unsigned int CID; // Collider ID
+// Registered colliders, densely packed in [0, collidersCount). Removing one moves the last collider
+// into its place, so the broadphases and the narrowphase only ever walk contiguous arrays.
+// All the per collider arrays are heap allocated and only ever grow (see EnsureCapacity), so once
+// a scene has warmed up adding colliders doesn't allocate.
+struct Collisions
+{
+	Collider** colliders;	// only dereferenced to call the callbacks
+	CID* handles;
+	ColliderType* types;
+	int* layers;
+	int* entityTypes;
+	Vector2* localPos;
+	float* speeds;				// speed bound of Collisions_SetVelocity, < 0 if unknown
+	unsigned int* speedEpochs;	// bumped when the speed bound stops holding, drops the pair skips of the collider
+	float* travel;				// distance moved since the last Collisions_CheckCollisions
+	bool* continuous;
+	bool* wraps;				// Collider::wrap
+	int collidersCount;
+	int capacity;
+
+	unsigned int layerMasks[MAX_COLLISION_LAYERS];
+	int layerCount;
+	BroadphaseType broadphase;
+	bool parallel;
+	bool wrap;
+	Vector2 wrapSize; // game.screenRect.size at the last Collisions_CheckCollisions
+
+	// Layer pairs (layer1 <= layer2) enabled by the masks, the only ones the broadphases visit
+	int layerPairs[MAX_COLLISION_LAYERS * (MAX_COLLISION_LAYERS + 1) / 2][2];
+	int layerPairsCount;
+};
+
+// Handle slots. A live slot holds the dense index of its collider, a free one the next free slot and a
+// retired one -1. The generation of a slot changes every time it is freed.
+struct ColliderSlots
+{
+	int* dense;
+	unsigned int* generation;
+	int count;
+	int freeList;
+};
+
+// Collider indices bucketed by layer, in index order inside each bucket
+struct LayerBuckets
+{
+	int start[MAX_COLLISION_LAYERS + 1]; // colliders of layer l are colliders[start[l]..start[l+1]-1]
+	int* colliders;
+};
+
+// Collider shapes in world space, written by Collisions_SetPosition
+struct ColliderShapes
+{
+	float* x;
+	float* y;
+	float* radius;
+
+	// Position at the last Collisions_CheckCollisions, and the radius of a circle around the current
+	// position that holds the collider everywhere in between. The broadphases use bounds, so they also
+	// find the pairs of continuous colliders that only touched halfway through the frame.
+	float* prevX;
+	float* prevY;
+	float* bounds;
+};
+
+// Uniform grid over game.screenRect. Colliders are binned by center, so with a cell size of at least
+// twice the largest radius two overlapping colliders are never more than one cell apart.
+// Colliders outside the screen are clamped into the border cells. In a wrapping world the cells on
+// opposite borders are neighbours for wrapping colliders, and there are no partial cells so that every cell is at least
+// cellSize wide, across the edges too.
+// Every layer has its own set of cells, so a cell lookup only ever sees colliders of the wanted layer.
+struct BroadphaseGrid
+{
+	Vector2 origin;
+	float cellSize;
+	int cellsX;
+	int cellsY;
+	int cellCount;
+	int* cellStart; // colliders of key k = layer*cellCount + cell are cellColliders[cellStart[k]..cellStart[k+1]-1]
+	int cellStartCapacity;
+	int* cellColliders;
+	int* colliderCell;
+	float maxRadius;
+	AABB bounds;	// of all the colliders
+	bool dirty;		// colliders were added, removed or moved since the last build
+};
 
-struct ColliderData
+// Sweep and prune along x. The endpoint list survives across frames: objects only move a few pixels
+// per frame, so re-sorting it with insertion sort is close to O(n).
+// Endpoints hold the handle of their collider, so removing one leaves its endpoints stale in place and
+// SapUpdate drops them in the pass that refreshes the values.
+#define SAP_MAX_ENDPOINT		0x1U
+#define SAP_MAX_INSERTIONS		64	// more new endpoints than this and the list is re-sorted from scratch
+struct SapEndpoint
 {
+	float value;
+	unsigned int data; // (collider index << 1) | SAP_MAX_ENDPOINT if it closes the interval, set by SapUpdate
 	CID cID;
-	Collider* collider;
 };
 
-struct Collisions
+struct BroadphaseSap
 {
-	CID gcID;
-	ColliderData colliders[MAX_COLLIDERS];
-	int collidersCount;
+	SapEndpoint* endpoints;
+	int endpointsCount;	// stale ones included until the next SapUpdate
+	int endpointsCapacity;
+	int addedCount; // endpoints appended since the last sort
+
+	// Open intervals, one list per layer
+	int* active[MAX_COLLISION_LAYERS];
+	int activeCount[MAX_COLLISION_LAYERS];
+	int* activePos;
+};
+
+// One dynamic AABB tree per layer, so layer pairs the matrix disables are never traversed. Only made
+// when it is the selected broadphase. The leaf userData is the dense collider index.
+struct BroadphaseTree
+{
+	AabbTree trees[MAX_COLLISION_LAYERS];
+	int* proxies; // dense, leaf of every collider
+	bool dirty;	  // colliders moved since the last TreeUpdate
+};
+
+// Dense collider indices of the queries while they search
+struct QueryScratch
+{
+	int* indices;
+	int capacity;
+};
+
+// Colliding pair found by the broadphase + narrowphase. Always idx1 < idx2 (dense indices).
+struct CollisionPair
+{
+	int idx1;
+	int idx2;
+};
+
+struct CollisionPairs
+{
+	CollisionPair* pairs;
+	int count;
+	int capacity;
+};
+
+// Candidate pairs from the broadphase waiting for the batched narrowphase
+struct NarrowphaseQueue
+{
+	CirclePairBatch circles;
+	int idx1[NARROWPHASE_BATCH_SIZE];
+	int idx2[NARROWPHASE_BATCH_SIZE];
+	unsigned int hitMask[NARROWPHASE_BATCH_SIZE / 32];
+};
+
+// A pair of colliders, both with a known speed bound, that was too far apart to touch before retestFrame.
+// key holds the two handles, lower one first, epoch1 and epoch2 their speed epochs in the same order.
+struct PairSkip
+{
+	unsigned long long key;	// 0 for an empty entry
+	unsigned int epoch1;
+	unsigned int epoch2;
+	unsigned int retestFrame;
+};
+
+// A pair of colliders touching in the last Collisions_CheckCollisions. Keyed by handles like PairSkip,
+// so it survives colliders moving around in the dense arrays.
+struct Contact
+{
+	unsigned long long key;
+	CID cID1;
+	CID cID2;
+	int entityType1;	// kept for the exit event of a collider that was removed
+	int entityType2;
+	bool touching;		// found again this frame
+};
+
+// The contacts of the last frame and an open addressing table over them, rebuilt every frame from the
+// hits. A hit found in the table is a stay, one that isn't an enter, and a contact no hit touched an exit.
+struct ContactCache
+{
+	Contact* contacts;
+	int count;
+	int capacity;
+	Contact* next;		// contacts of this frame while they are collected
+	int nextCount;
+	int* table;			// indices into contacts, -1 for an empty entry
+	int tableCapacity;	// power of 2
+};
+
+// Open addressing table of PairSkips, linear probing. Entries are never removed one by one, the expired
+// and stale ones are dropped when the table is rehashed.
+struct PairSkipCache
+{
+	PairSkip* entries;
+	PairSkip* scratch;
+	int capacity;	// power of 2
+	int count;
+	unsigned int frame; // Collisions_CheckCollisions calls so far
+	unsigned int nextEpoch; // speed epochs are never reused, so a recycled handle can't match an old entry
+};
+
+// Every thread of the pair search batches its candidates and collects its hits separately. The hit
+// lists are merged and sorted afterwards, so the result doesn't depend on how the work was split.
+struct PairWorker
+{
+	NarrowphaseQueue narrowphase;
+	CollisionPairs hits;
+	int candidatePairs;
+	int pairsSkipped;
+	int narrowphaseTests;
 
-	int matrix[MAX_COLLISION_LAYERS][MAX_COLLISION_LAYERS];
+	// Skips found during the pair search, the cache is only read while workers run
+	PairSkip* newSkips;
+	int newSkipsCount;
+	int newSkipsCapacity;
 };
 
-struct CallbackData
+struct PairWorkers
 {
-	void(*func)(Collider*, Collider*);
-	Collider* collider1;
-	Collider* collider2;
+	PairWorker* workers;
+	int count;
 };
 
+#define QUEUED_PHASES	2	// enter or stay, exit
+
 struct CollisionCallback
 {
-	CallbackData queue[MAX_COLLIDERS];
+	CollisionEvent* queue;	// every collider is queued at most once per phase, so it never holds more than QUEUED_PHASES * capacity
+	int* ranks;				// dispatch rank of the pair type of each queued event
 	int count;
-	unsigned int callbackInQueueBm[MAX_COLLIDERS / 32];
+	unsigned int* callbackInQueueBm; // QUEUED_PHASES bitmaps of capacity bits
+
+	// The queue bucketed by dispatch rank. Only grown by Collisions_CheckCollisions, not EnsureCapacity,
+	// so handlers adding colliders don't move the events they are walking.
+	CollisionEvent* sorted;
+	int sortedCapacity;
+};
+
+// Pair type = typeA * MAX_COLLISION_ENTITY_TYPES + typeB. Pair types with a handler get the ranks
+// [0, handlerCount) in the order the handlers were set, the others PAIR_TYPES + pair type.
+struct PairDispatch
+{
+	CollisionPairHandler handlers[PAIR_TYPES];
+	unsigned int phases[PAIR_TYPES];	// CollisionPhases the handler wants
+	int rank[PAIR_TYPES];
+	int pairType[PAIR_RANKS];	// inverse of rank
+	int handlerCount;
 };
 static Collisions collisions;
+static ColliderSlots slots;
 static CollisionCallback collisionCallback;
+static PairDispatch pairDispatch;
+static BroadphaseGrid grid;
+static BroadphaseSap sap;
+static BroadphaseTree tree;
+static QueryScratch queryScratch;
+static CollisionPairs collisionPairs;
+static ColliderShapes shapes;
+static LayerBuckets buckets;
+static PairWorkers pairWorkers;
+static PairSkipCache pairSkips;
+static ContactCache contactCache;
+static CollisionStats stats;
 
-static bool InCallbackQueue(ColliderData collider);
-static void AddToCallbackQueue(ColliderData collider1, ColliderData collider2);
-static bool CircleCircleCollision(Collider* collider1, Collider* collider2);
+static void QueueEvent(CID cID, CID otherCID, Collider* otherCollider, int pairType, CollisionPhase phase);
+static void QueueContactEvents();
+static void DispatchCallbacks();
+static void GridBuild();
+static void GridEnsureBuilt();
+static void GridFindPairs();
+static void SapAdd(int idx);
+static void SapUpdate();
+static void SapFindPairs();
+static void BruteForceFindPairs();
+static void TreeAdd(int idx);
+static void TreeRemove(int idx, int last);
+static void TreeUpdate();
+static void TreeFindPairs();
+static void EnsureCapacity(int count);
+static int ColliderIndex(CID cID);
+static void FreeSlot(int slot);
+static void BuildLayerBuckets();
+static void RunPairSearch(JobsRangeFunc func, void* context, int count);
+static void TestPair(PairWorker* worker, int idx1, int idx2);
+static void TestSweptPair(PairWorker* worker, int idx1, int idx2, float offsetX, float offsetY);
+static void AddHit(CollisionPairs* hits, int idx1, int idx2);
+static bool SkipPair(PairWorker* worker, int idx1, int idx2, float offsetX, float offsetY);
+static void StorePairSkips();
+static void FlushNarrowphase(PairWorker* worker);
+static void MergeHits();
+static int ComparePairs(const void* a, const void* b);
+static void StageLap(CollisionStage stage, unsigned long long* last);
 
-void Collisions_Init(int collisionMatrix[][3], int collisionLayers)
+void Collisions_Init(const unsigned int layerMasks[], int collisionLayers, BroadphaseType broadphase, bool parallel)
 {
 	assert(collisionLayers <= MAX_COLLISION_LAYERS);
-	collisions = { 0 };
-	collisions.collidersCount = 0;
+	collisions.layerPairsCount = 0;
+	for (int i = 0; i < MAX_COLLISION_LAYERS; i++)
+	{
+		collisions.layerMasks[i] = 0;
+	}
 	for (int i = 0; i < collisionLayers; i++)
 	{
 		for (int j = 0; j < collisionLayers; j++)
 		{
-			collisions.matrix[i][j] = collisionMatrix[i][j];
+			if (layerMasks[i] & COLLISION_LAYER_BIT(j))
+			{
+				collisions.layerMasks[i] |= COLLISION_LAYER_BIT(j);
+				collisions.layerMasks[j] |= COLLISION_LAYER_BIT(i);
+			}
 		}
 	}
-	collisionCallback.count = 0;
+	for (int i = 0; i < collisionLayers; i++)
+	{
+		for (int j = i; j < collisionLayers; j++)
+		{
+			if (collisions.layerMasks[i] & COLLISION_LAYER_BIT(j))
+			{
+				collisions.layerPairs[collisions.layerPairsCount][0] = i;
+				collisions.layerPairs[collisions.layerPairsCount][1] = j;
+				collisions.layerPairsCount++;
+			}
+		}
+	}
+	pairDispatch.handlerCount = 0;
+	for (int t = 0; t < PAIR_TYPES; t++)
+	{
+		pairDispatch.handlers[t] = NULL;
+		pairDispatch.phases[t] = COLLISION_ENTER | COLLISION_STAY;
+		pairDispatch.rank[t] = PAIR_TYPES + t;
+		pairDispatch.pairType[PAIR_TYPES + t] = t;
+	}
+	collisions.layerCount = collisionLayers;
+	collisions.broadphase = broadphase;
+	collisions.parallel = parallel;
+	collisions.wrap = false;
+	for (int i = 0; i < MAX_COLLISION_LAYERS; i++)
+	{
+		if (tree.trees[i].nodes) AabbTree_Free(&tree.trees[i]);
+		if (broadphase == BROADPHASE_TREE && i < collisionLayers) AabbTree_Init(&tree.trees[i], COLLIDERS_MIN_CAPACITY, TREE_FAT_MARGIN);
+	}
+	EnsureCapacity(COLLIDERS_MIN_CAPACITY);
+	for (int l = 0; l < collisionLayers; l++)
+	{
+		sap.active[l] = (int*)realloc(sap.active[l], sizeof(int) * collisions.capacity);
+	}
+	Collisions_Clear();
 }
 
 void Collisions_Clear()
 {
 	collisions.collidersCount = 0;
+	grid.dirty = true;
 	collisionCallback.count = 0;
+	contactCache.count = 0;
+	if (contactCache.table) memset(contactCache.table, 0xff, sizeof(int) * contactCache.tableCapacity);
+	sap.endpointsCount = 0;
+	sap.addedCount = 0;
+	for (int i = 0; i < collisions.layerCount && collisions.broadphase == BROADPHASE_TREE; i++)
+	{
+		AabbTree_Clear(&tree.trees[i]);
+	}
+
+	// Free every slot, the new generation makes the handles given out so far stale. Backwards so the
+	// slots are reused in index order
+	slots.freeList = -1;
+	for (int s = slots.count - 1; s >= 0; s--)
+	{
+		if (slots.generation[s] != CID_MAX_GENERATION) FreeSlot(s);
+	}
+}
+
+void Collisions_SetWrap(bool wrap)
+{
+	// The SAP endpoint list and the AABB trees have no notion of the world edges
+	assert(!wrap || collisions.broadphase == BROADPHASE_BRUTE_FORCE || collisions.broadphase == BROADPHASE_GRID);
+	collisions.wrap = wrap;
+	grid.dirty = true;
 }
 
 void Collisions_NewFrame()
 {
-	collisions.gcID = 0;
-	collisions.collidersCount = 0;
 	collisionCallback.count = 0;
-	for (int i = 0; i < MAX_COLLIDERS / 32; i++)
+}
+
+CID Collisions_AddCollider(Collider* collider, Vector2 pos)
+{
+	int idx = collisions.collidersCount;
+	assert(0 <= collider->layer && collider->layer < collisions.layerCount);
+	assert(0 <= collider->entityType && collider->entityType < MAX_COLLISION_ENTITY_TYPES);
+	if (idx == collisions.capacity) EnsureCapacity(idx + 1);
+
+	int slot;
+	if (slots.freeList != -1)
+	{
+		slot = slots.freeList;
+		slots.freeList = slots.dense[slot];
+	}
+	else
+	{
+		slot = slots.count++;
+		slots.generation[slot] = 0;
+	}
+	assert(slot < (1 << CID_INDEX_BITS));
+	slots.dense[slot] = idx;
+
+	CID cID = (slots.generation[slot] << CID_INDEX_BITS) | (CID)slot;
+	collisions.colliders[idx] = collider;
+	collisions.handles[idx] = cID;
+	collisions.types[idx] = collider->colliderType;
+	collisions.layers[idx] = collider->layer;
+	collisions.entityTypes[idx] = collider->entityType;
+	collisions.speeds[idx] = -1.0f;
+	collisions.speedEpochs[idx] = pairSkips.nextEpoch++;
+	collisions.travel[idx] = 0.0f;
+	collisions.continuous[idx] = collider->continuous;
+	collisions.wraps[idx] = collider->wrap;
+	switch (collider->colliderType)
+	{
+	case COLLIDER_CIRCLE:
+		collisions.localPos[idx] = collider->circle.localPos;
+		shapes.radius[idx] = collider->circle.radius;
+		break;
+	case COLLIDER_BOX:  // falling through on purpose until implemented...
+	InvalidDefaultCase;
+	}
+	shapes.x[idx] = pos.x + collisions.localPos[idx].x;
+	shapes.y[idx] = pos.y + collisions.localPos[idx].y;
+	shapes.prevX[idx] = shapes.x[idx];
+	shapes.prevY[idx] = shapes.y[idx];
+	shapes.bounds[idx] = shapes.radius[idx];
+	collisions.collidersCount = idx + 1;
+	collider->cID = cID;
+	grid.dirty = true;
+
+	if (collisions.broadphase == BROADPHASE_SAP)  SapAdd(idx);
+	if (collisions.broadphase == BROADPHASE_TREE) TreeAdd(idx);
+	return cID;
+}
+
+void Collisions_RemoveCollider(CID cID)
+{
+	int idx = ColliderIndex(cID);
+	assert(idx >= 0);
+	int last = collisions.collidersCount - 1;
+
+	if (collisions.broadphase == BROADPHASE_TREE) TreeRemove(idx, last);
+
+	FreeSlot(CID_INDEX(cID));
+
+	// Move the last collider into the hole
+	if (idx != last)
+	{
+		collisions.colliders[idx] = collisions.colliders[last];
+		collisions.handles[idx] = collisions.handles[last];
+		collisions.types[idx] = collisions.types[last];
+		collisions.layers[idx] = collisions.layers[last];
+		collisions.entityTypes[idx] = collisions.entityTypes[last];
+		collisions.speeds[idx] = collisions.speeds[last];
+		collisions.speedEpochs[idx] = collisions.speedEpochs[last];
+		collisions.travel[idx] = collisions.travel[last];
+		collisions.continuous[idx] = collisions.continuous[last];
+		collisions.wraps[idx] = collisions.wraps[last];
+		collisions.localPos[idx] = collisions.localPos[last];
+		shapes.x[idx] = shapes.x[last];
+		shapes.y[idx] = shapes.y[last];
+		shapes.radius[idx] = shapes.radius[last];
+		shapes.prevX[idx] = shapes.prevX[last];
+		shapes.prevY[idx] = shapes.prevY[last];
+		shapes.bounds[idx] = shapes.bounds[last];
+		tree.proxies[idx] = tree.proxies[last];
+		slots.dense[CID_INDEX(collisions.handles[idx])] = idx;
+	}
+	collisions.collidersCount = last;
+	grid.dirty = true;
+}
+
+void Collisions_SetPosition(CID cID, Vector2 pos)
+{
+	int idx = ColliderIndex(cID);
+	assert(idx >= 0);
+	float x = pos.x + collisions.localPos[idx].x;
+	float y = pos.y + collisions.localPos[idx].y;
+	if (collisions.speeds[idx] >= 0.0f)
+	{
+		// Moving further than the speed bound allows (teleport, wrap around) breaks the pair skips
+		float dx = x - shapes.x[idx];
+		float dy = y - shapes.y[idx];
+		collisions.travel[idx] += sqrtf(dx * dx + dy * dy);
+		if (collisions.travel[idx] > collisions.speeds[idx] * game.deltaT + PAIR_SKIP_SLOP)
+		{
+			collisions.speedEpochs[idx] = pairSkips.nextEpoch++;
+		}
+	}
+	shapes.x[idx] = x;
+	shapes.y[idx] = y;
+	if (collisions.continuous[idx])
+	{
+		float sweepX = x - shapes.prevX[idx];
+		float sweepY = y - shapes.prevY[idx];
+		shapes.bounds[idx] = shapes.radius[idx] + sqrtf(sweepX * sweepX + sweepY * sweepY);
+	}
+	grid.dirty = true;
+	tree.dirty = true;
+}
+
+void Collisions_Teleport(CID cID, Vector2 pos)
+{
+	int idx = ColliderIndex(cID);
+	assert(idx >= 0);
+	shapes.x[idx] = shapes.prevX[idx] = pos.x + collisions.localPos[idx].x;
+	shapes.y[idx] = shapes.prevY[idx] = pos.y + collisions.localPos[idx].y;
+	shapes.bounds[idx] = shapes.radius[idx];
+	collisions.speedEpochs[idx] = pairSkips.nextEpoch++;
+	grid.dirty = true;
+	tree.dirty = true;
+}
+
+void Collisions_SetVelocity(CID cID, Vector2 vel)
+{
+	int idx = ColliderIndex(cID);
+	assert(idx >= 0);
+	float speed = Magnitude(vel);
+	if (speed > collisions.speeds[idx]) collisions.speedEpochs[idx] = pairSkips.nextEpoch++;
+	collisions.speeds[idx] = speed;
+}
+
+void Collisions_SetColliderRef(CID cID, Collider* collider)
+{
+	int idx = ColliderIndex(cID);
+	assert(idx >= 0);
+	collisions.colliders[idx] = collider;
+}
+
+Collider* Collisions_GetCollider(CID cID)
+{
+	int idx = ColliderIndex(cID);
+	return idx >= 0 ? collisions.colliders[idx] : NULL;
+}
+
+void Collisions_SetPairHandler(int typeA, int typeB, CollisionPairHandler handler, unsigned int phases)
+{
+	assert(0 <= typeA && typeA < MAX_COLLISION_ENTITY_TYPES);
+	assert(0 <= typeB && typeB < MAX_COLLISION_ENTITY_TYPES);
+	int pairType = typeA * MAX_COLLISION_ENTITY_TYPES + typeB;
+	if (pairDispatch.rank[pairType] >= PAIR_TYPES)
 	{
-		collisionCallback.callbackInQueueBm[i] = 0U;
+		int rank = pairDispatch.handlerCount++;
+		pairDispatch.rank[pairType] = rank;
+		pairDispatch.pairType[rank] = pairType;
 	}
+	pairDispatch.handlers[pairType] = handler;
+	pairDispatch.phases[pairType] = phases;
 }
 
-void Collisions_AddCollider(Collider* collider)
+bool Collisions_ResolveEvent(const CollisionEvent* event, Collider** collider, Collider** otherCollider)
 {
-	int count = collisions.collidersCount;
-	collisions.colliders[count].cID = collisions.gcID++;
-	collisions.colliders[count].collider = collider;
-	collisions.collidersCount = count + 1;
+	*collider = Collisions_GetCollider(event->cID);
+	if (!*collider) return false;
+	*otherCollider = Collisions_GetCollider(event->otherCID);
+	if (!*otherCollider) *otherCollider = event->otherCollider;
+	return true;
 }
 
 void Collisions_DebugShowColliders()
 {
 	for (int i = 0; i < collisions.collidersCount; i++)
 	{
-		Collider* collider = collisions.colliders[i].collider;
-		switch (collider->colliderType)
+		Debug_DrawCircle(V2(shapes.x[i], shapes.y[i]), shapes.radius[i], COL32_GREEN);
+	}
+}
+
+void Collisions_DebugShowGrid()
+{
+	GridEnsureBuilt();
+	int maxOccupancy = 0;
+	for (int cell = 0; cell < grid.cellCount; cell++)
+	{
+		int occupancy = 0;
+		for (int l = 0; l < collisions.layerCount; l++)
 		{
-		case COLLIDER_CIRCLE:
-			Debug_DrawCircle(*collider->posRef + collider->circle.localPos, collider->circle.radius, COL32_GREEN);
-			break;
-		case COLLIDER_BOX:  // falling through on purpose until implemented...
-		InvalidDefaultCase;
+			int key = l * grid.cellCount + cell;
+			occupancy += grid.cellStart[key + 1] - grid.cellStart[key];
+		}
+		if (occupancy > maxOccupancy) maxOccupancy = occupancy;
+	}
+
+	for (int cell = 0; cell < grid.cellCount; cell++)
+	{
+		int occupancy = 0;
+		for (int l = 0; l < collisions.layerCount; l++)
+		{
+			int key = l * grid.cellCount + cell;
+			occupancy += grid.cellStart[key + 1] - grid.cellStart[key];
 		}
+		if (occupancy == 0) continue;
+
+		// In a wrapping world the last cells take the remainder up to the world edge
+		int cx = cell % grid.cellsX;
+		int cy = cell / grid.cellsX;
+		Vector2 cellPos = grid.origin + grid.cellSize * V2((float)cx, (float)cy);
+		Vector2 cellSize = grid.cellSize * VECTOR2_ONE;
+		if (collisions.wrap && cx == grid.cellsX - 1) cellSize.x = game.screenRect.size.x - cx * grid.cellSize;
+		if (collisions.wrap && cy == grid.cellsY - 1) cellSize.y = game.screenRect.size.y - cy * grid.cellSize;
+		int heat = maxOccupancy > 1 ? 255 * (occupancy - 1) / (maxOccupancy - 1) : 255;
+		int cold = 255 - heat;
+		Debug_DrawFilledRect(RectNew(cellPos, cellSize), COL32A(heat, 0, cold, 96));
 	}
 }
 
 void Collisions_CheckCollisions()
 {
+	int threadCount = collisions.parallel ? Jobs_GetThreadCount() : 1;
+	if (threadCount > pairWorkers.count)
+	{
+		pairWorkers.workers = (PairWorker*)realloc(pairWorkers.workers, sizeof(PairWorker) * threadCount);
+		assert(pairWorkers.workers != NULL);
+		memset(&pairWorkers.workers[pairWorkers.count], 0, sizeof(PairWorker) * (threadCount - pairWorkers.count));
+		pairWorkers.count = threadCount;
+	}
+	for (int t = 0; t < pairWorkers.count; t++)
+	{
+		pairWorkers.workers[t].narrowphase.circles.count = 0;
+		pairWorkers.workers[t].hits.count = 0;
+		pairWorkers.workers[t].candidatePairs = 0;
+		pairWorkers.workers[t].pairsSkipped = 0;
+		pairWorkers.workers[t].narrowphaseTests = 0;
+		pairWorkers.workers[t].newSkipsCount = 0;
+	}
+	pairSkips.frame++;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	collisions.wrapSize = game.screenRect.size;
+
+	unsigned long long cycles = ReadCycleCounter();
+	BuildLayerBuckets();
+	StageLap(COLLISION_STAGE_BUCKETS, &cycles);
+	switch (collisions.broadphase)
+	{
+	case BROADPHASE_BRUTE_FORCE:
+		StageLap(COLLISION_STAGE_BROADPHASE_UPDATE, &cycles);
+		BruteForceFindPairs();
+		break;
+	case BROADPHASE_GRID:
+		GridBuild();
+		StageLap(COLLISION_STAGE_BROADPHASE_UPDATE, &cycles);
+		GridFindPairs();
+		break;
+	case BROADPHASE_SAP:
+		SapUpdate();
+		StageLap(COLLISION_STAGE_BROADPHASE_UPDATE, &cycles);
+		SapFindPairs();
+		break;
+	case BROADPHASE_TREE:
+		TreeUpdate();
+		StageLap(COLLISION_STAGE_BROADPHASE_UPDATE, &cycles);
+		TreeFindPairs();
+		break;
+	InvalidDefaultCase;
+	}
+	for (int t = 0; t < pairWorkers.count; t++)
+	{
+		FlushNarrowphase(&pairWorkers.workers[t]);
+	}
+	StageLap(COLLISION_STAGE_PAIR_SEARCH, &cycles);
+	MergeHits();
+	StorePairSkips();
+	memset(collisions.travel, 0, sizeof(float) * collisions.collidersCount);
+	memcpy(shapes.prevX, shapes.x, sizeof(float) * collisions.collidersCount);
+	memcpy(shapes.prevY, shapes.y, sizeof(float) * collisions.collidersCount);
+	memcpy(shapes.bounds, shapes.radius, sizeof(float) * collisions.collidersCount);
+
+	// The broadphase finds pairs in its own order. Sort them back into (idx1, idx2) order so the callback
+	// queue is filled exactly like a full pair loop over the colliders would fill it.
+	qsort(collisionPairs.pairs, collisionPairs.count, sizeof(CollisionPair), ComparePairs);
+	QueueContactEvents();
+	StageLap(COLLISION_STAGE_MERGE, &cycles);
+	stats.colliders = collisions.collidersCount;
+	stats.hits = collisionPairs.count;
+	stats.callbacks = collisionCallback.count;
+	stats.candidatePairs = 0;
+	stats.pairsSkipped = 0;
+	stats.narrowphaseTests = 0;
+	for (int t = 0; t < pairWorkers.count; t++)
+	{
+		stats.candidatePairs += pairWorkers.workers[t].candidatePairs;
+		stats.pairsSkipped += pairWorkers.workers[t].pairsSkipped;
+		stats.narrowphaseTests += pairWorkers.workers[t].narrowphaseTests;
+	}
+	assert(stats.candidatePairs == stats.pairsSkipped + stats.narrowphaseTests);
+
+	DispatchCallbacks();
+	StageLap(COLLISION_STAGE_CALLBACKS, &cycles);
+	stats.milliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+const CollisionStats* Collisions_GetStats()
+{
+	return &stats;
+}
+
+// Stores the cycles since *last as the time of the stage and restarts the count
+static void StageLap(CollisionStage stage, unsigned long long* last)
+{
+	unsigned long long now = ReadCycleCounter();
+	stats.cycles[stage] = now - *last;
+	*last = now;
+}
+
+static void* GrowArray(void* data, size_t elemSize, int capacity)
+{
+	data = realloc(data, elemSize * capacity);
+	assert(data != NULL);
+	return data;
+}
+
+// Makes room for at least count colliders in every per collider array, doubling the capacity
+static void EnsureCapacity(int count)
+{
+	if (count <= collisions.capacity) return;
+
+	int capacity = collisions.capacity > 0 ? collisions.capacity : COLLIDERS_MIN_CAPACITY;
+	while (capacity < count) capacity *= 2;
+
+	collisions.colliders = (Collider**)GrowArray(collisions.colliders, sizeof(Collider*), capacity);
+	collisions.handles = (CID*)GrowArray(collisions.handles, sizeof(CID), capacity);
+	collisions.types = (ColliderType*)GrowArray(collisions.types, sizeof(ColliderType), capacity);
+	collisions.layers = (int*)GrowArray(collisions.layers, sizeof(int), capacity);
+	collisions.entityTypes = (int*)GrowArray(collisions.entityTypes, sizeof(int), capacity);
+	collisions.localPos = (Vector2*)GrowArray(collisions.localPos, sizeof(Vector2), capacity);
+	collisions.speeds = (float*)GrowArray(collisions.speeds, sizeof(float), capacity);
+	collisions.speedEpochs = (unsigned int*)GrowArray(collisions.speedEpochs, sizeof(unsigned int), capacity);
+	collisions.travel = (float*)GrowArray(collisions.travel, sizeof(float), capacity);
+	collisions.continuous = (bool*)GrowArray(collisions.continuous, sizeof(bool), capacity);
+	collisions.wraps = (bool*)GrowArray(collisions.wraps, sizeof(bool), capacity);
+	slots.dense = (int*)GrowArray(slots.dense, sizeof(int), capacity);
+	slots.generation = (unsigned int*)GrowArray(slots.generation, sizeof(unsigned int), capacity);
+	shapes.x = (float*)GrowArray(shapes.x, sizeof(float), capacity);
+	shapes.y = (float*)GrowArray(shapes.y, sizeof(float), capacity);
+	shapes.radius = (float*)GrowArray(shapes.radius, sizeof(float), capacity);
+	shapes.prevX = (float*)GrowArray(shapes.prevX, sizeof(float), capacity);
+	shapes.prevY = (float*)GrowArray(shapes.prevY, sizeof(float), capacity);
+	shapes.bounds = (float*)GrowArray(shapes.bounds, sizeof(float), capacity);
+	buckets.colliders = (int*)GrowArray(buckets.colliders, sizeof(int), capacity);
+	grid.cellColliders = (int*)GrowArray(grid.cellColliders, sizeof(int), capacity);
+	grid.colliderCell = (int*)GrowArray(grid.colliderCell, sizeof(int), capacity);
+	sap.activePos = (int*)GrowArray(sap.activePos, sizeof(int), capacity);
+	tree.proxies = (int*)GrowArray(tree.proxies, sizeof(int), capacity);
+	for (int l = 0; l < collisions.layerCount; l++)
+	{
+		sap.active[l] = (int*)GrowArray(sap.active[l], sizeof(int), capacity);
+	}
+	collisionCallback.queue = (CollisionEvent*)GrowArray(collisionCallback.queue, sizeof(CollisionEvent), QUEUED_PHASES * capacity);
+	collisionCallback.ranks = (int*)GrowArray(collisionCallback.ranks, sizeof(int), QUEUED_PHASES * capacity);
+	collisionCallback.callbackInQueueBm = (unsigned int*)GrowArray(collisionCallback.callbackInQueueBm, sizeof(unsigned int), QUEUED_PHASES * ((capacity + 31) / 32));
+	collisions.capacity = capacity;
+}
+
+// Moves the slot to the next generation and onto the free list, or retires it once its generations run out
+// so that no handle can come back to life
+static void FreeSlot(int slot)
+{
+	slots.generation[slot]++;
+	if (slots.generation[slot] == CID_MAX_GENERATION)
+	{
+		slots.dense[slot] = -1;
+		return;
+	}
+	slots.dense[slot] = slots.freeList;
+	slots.freeList = slot;
+}
+
+// Dense index of a live handle, -1 if the collider was removed
+static int ColliderIndex(CID cID)
+{
+	int slot = CID_INDEX(cID);
+	if (cID == INVALID_CID || slot >= slots.count) return -1;
+	if (slots.generation[slot] != CID_GENERATION(cID)) return -1;
+	return slots.dense[slot];
+}
+
+static void BuildLayerBuckets()
+{
+	for (int l = 0; l <= collisions.layerCount; l++)
+	{
+		buckets.start[l] = 0;
+	}
+	for (int i = 0; i < collisions.collidersCount; i++)
+	{
+		buckets.start[collisions.layers[i]]++;
+	}
+	for (int l = 1; l <= collisions.layerCount; l++)
+	{
+		buckets.start[l] += buckets.start[l - 1];
+	}
+	for (int i = collisions.collidersCount - 1; i >= 0; i--)
+	{
+		int slot = --buckets.start[collisions.layers[i]];
+		buckets.colliders[slot] = i;
+	}
+}
+
+static int GridCoord(float x, float origin, int cells)
+{
+	int c = (int)floorf((x - origin) / grid.cellSize);
+	if (c < 0) return 0;
+	if (c >= cells) return cells - 1;
+	return c;
+}
+
+static void GridBuild()
+{
+	Rect worldRect = game.screenRect;
+	float maxRadius = 0.0f;
+	AABB bounds = AabbNew(V2(FLT_MAX, FLT_MAX), V2(-FLT_MAX, -FLT_MAX));
+	for (int i = 0; i < collisions.collidersCount; i++)
+	{
+		float radius = shapes.bounds[i];
+		if (radius > maxRadius) maxRadius = radius;
+		if (shapes.x[i] - radius < bounds.min.x) bounds.min.x = shapes.x[i] - radius;
+		if (shapes.y[i] - radius < bounds.min.y) bounds.min.y = shapes.y[i] - radius;
+		if (shapes.x[i] + radius > bounds.max.x) bounds.max.x = shapes.x[i] + radius;
+		if (shapes.y[i] + radius > bounds.max.y) bounds.max.y = shapes.y[i] + radius;
+	}
+	grid.maxRadius = maxRadius;
+	grid.bounds = bounds;
+	grid.dirty = false;
+
+	// Cell size comes from the largest collider, but don't use many more cells than colliders
+	int maxCellsPerAxis = (int)sqrtf((float)collisions.collidersCount) + 1;
+	if (maxCellsPerAxis > GRID_MAX_CELLS_PER_AXIS) maxCellsPerAxis = GRID_MAX_CELLS_PER_AXIS;
+	float worldSize = worldRect.size.x > worldRect.size.y ? worldRect.size.x : worldRect.size.y;
+	float minCellSize = worldSize / maxCellsPerAxis;
+	grid.cellSize = 2.0f * maxRadius > minCellSize ? 2.0f * maxRadius : minCellSize;
+	grid.origin = worldRect.pos;
+	if (collisions.wrap)
+	{
+		// The last cell takes the remainder, GridCoord clamps into it
+		grid.cellsX = (int)floorf(worldRect.size.x / grid.cellSize);
+		grid.cellsY = (int)floorf(worldRect.size.y / grid.cellSize);
+	}
+	else
+	{
+		grid.cellsX = (int)ceilf(worldRect.size.x / grid.cellSize);
+		grid.cellsY = (int)ceilf(worldRect.size.y / grid.cellSize);
+	}
+	if (grid.cellsX < 1) grid.cellsX = 1;
+	if (grid.cellsY < 1) grid.cellsY = 1;
+	assert(grid.cellsX <= GRID_MAX_CELLS_PER_AXIS && grid.cellsY <= GRID_MAX_CELLS_PER_AXIS);
+
+	// Counting sort of the colliders by (layer, cell) (cellStart holds the ends until the last pass)
+	grid.cellCount = grid.cellsX * grid.cellsY;
+	int keyCount = collisions.layerCount * grid.cellCount;
+	if (keyCount + 1 > grid.cellStartCapacity)
+	{
+		grid.cellStartCapacity = keyCount + 1;
+		grid.cellStart = (int*)GrowArray(grid.cellStart, sizeof(int), grid.cellStartCapacity);
+	}
+	for (int k = 0; k <= keyCount; k++)
+	{
+		grid.cellStart[k] = 0;
+	}
 	for (int i = 0; i < collisions.collidersCount; i++)
 	{
-		ColliderData collider1 = collisions.colliders[i];
-		for (int j = i + 1; j < collisions.collidersCount; j++)
+		int cx = GridCoord(shapes.x[i], grid.origin.x, grid.cellsX);
+		int cy = GridCoord(shapes.y[i], grid.origin.y, grid.cellsY);
+		int cell = cy * grid.cellsX + cx;
+		grid.colliderCell[i] = cell;
+		grid.cellStart[collisions.layers[i] * grid.cellCount + cell]++;
+	}
+	for (int k = 1; k <= keyCount; k++)
+	{
+		grid.cellStart[k] += grid.cellStart[k - 1];
+	}
+	for (int i = collisions.collidersCount - 1; i >= 0; i--)
+	{
+		int key = collisions.layers[i] * grid.cellCount + grid.colliderCell[i];
+		int slot = --grid.cellStart[key];
+		grid.cellColliders[slot] = i;
+	}
+}
+
+// Pair search jobs run over the colliders of layer1, tested against layer2
+struct PairSearchJob
+{
+	int layer1;
+	int layer2;
+};
+
+// Cell coordinates next to c (and c itself) along an axis of cells cells, wrapped around if wrap is set.
+// None is listed twice, even when there are less than 3 cells.
+static int GridNeighbours(int c, int cells, bool wrap, int neighbours[3])
+{
+	int count = 0;
+	for (int n = c - 1; n <= c + 1; n++)
+	{
+		int wrapped = n;
+		if (wrap)                              wrapped = (n + cells) % cells;
+		else if (n < 0 || n >= cells)          continue;
+		if (count > 0 && neighbours[0] == wrapped) continue;
+		if (count > 1 && neighbours[1] == wrapped) continue;
+		neighbours[count++] = wrapped;
+	}
+	return count;
+}
+
+static void GridFindPairsRange(void* context, int begin, int end, int threadIndex)
+{
+	PairSearchJob* job = (PairSearchJob*)context;
+	PairWorker* worker = &pairWorkers.workers[threadIndex];
+	int* cellStart = &grid.cellStart[job->layer2 * grid.cellCount];
+	for (int b = buckets.start[job->layer1] + begin; b < buckets.start[job->layer1] + end; b++)
+	{
+		int i = buckets.colliders[b];
+		int cell = grid.colliderCell[i];
+		// Only a pair of wrapping colliders touches across the edges. A mixed pair found across them by
+		// the wrapping one fails the narrowphase, both find each other when really next to each other.
+		bool wrap = collisions.wrap && collisions.wraps[i];
+		int xs[3];
+		int ys[3];
+		int xCount = GridNeighbours(cell % grid.cellsX, grid.cellsX, wrap, xs);
+		int yCount = GridNeighbours(cell / grid.cellsX, grid.cellsY, wrap, ys);
+		for (int ny = 0; ny < yCount; ny++)
 		{
-			ColliderData collider2 = collisions.colliders[j];
-			bool collisionAllowed = collisions.matrix[collider1.collider->layer][collider2.collider->layer];
-			if (collisionAllowed)
+			for (int nx = 0; nx < xCount; nx++)
 			{
-				int collisionType = collider1.collider->colliderType | collider2.collider->colliderType;
-				switch (collisionType)
+				int neighbourCell = ys[ny] * grid.cellsX + xs[nx];
+				for (int k = cellStart[neighbourCell]; k < cellStart[neighbourCell + 1]; k++)
 				{
-				case COLLISION_CIRLE_CIRCLE:
-					if (CircleCircleCollision(collider1.collider, collider2.collider))
-					{
-						// Add to Queue (dont call callback in here, since we usually destroy things at calllback and this is a loop)
-						if (!InCallbackQueue(collider1)) AddToCallbackQueue(collider1, collider2);
-						if (!InCallbackQueue(collider2)) AddToCallbackQueue(collider2, collider1);
-					}
-					break;
-				case COLLISION_BOX_BOX:
-				case COLLISION_CIRCLE_BOX: // falling through on purpose until implemented...
-				InvalidDefaultCase;
+					int j = grid.cellColliders[k];
+					if (job->layer1 != job->layer2) TestPair(worker, i, j);
+					else if (j > i)                 TestPair(worker, i, j); // same layer, every pair is seen from both sides
 				}
 			}
 		}
 	}
+}
+
+static void GridEnsureBuilt()
+{
+	if (grid.dirty) GridBuild();
+}
 
-	// Call callback functions (if any)
-	for (int i = 0; i < collisionCallback.count; i++)
+static void GridFindPairs()
+{
+	for (int p = 0; p < collisions.layerPairsCount; p++)
 	{
-		Collider* collider1 = collisionCallback.queue[i].collider1;
-		Collider* collider2 = collisionCallback.queue[i].collider2;
-		(*collisionCallback.queue[i].func)(collider1, collider2);
+		PairSearchJob job = { collisions.layerPairs[p][0], collisions.layerPairs[p][1] };
+		RunPairSearch(GridFindPairsRange, &job, buckets.start[job.layer1 + 1] - buckets.start[job.layer1]);
 	}
 }
 
-static bool CircleCircleCollision(Collider* collider1, Collider* collider2)
+static void BruteForceFindPairsRange(void* context, int begin, int end, int threadIndex)
 {
-	Vector2 pos1 = *collider1->posRef + collider1->circle.localPos;
-	Vector2 pos2 = *collider2->posRef + collider2->circle.localPos;
+	PairSearchJob* job = (PairSearchJob*)context;
+	PairWorker* worker = &pairWorkers.workers[threadIndex];
+	for (int b1 = buckets.start[job->layer1] + begin; b1 < buckets.start[job->layer1] + end; b1++)
+	{
+		int b2 = job->layer1 == job->layer2 ? b1 + 1 : buckets.start[job->layer2];
+		for (; b2 < buckets.start[job->layer2 + 1]; b2++)
+		{
+			TestPair(worker, buckets.colliders[b1], buckets.colliders[b2]);
+		}
+	}
+}
 
-	float radius1 = collider1->circle.radius;
-	float radius2 = collider2->circle.radius;
+static void BruteForceFindPairs()
+{
+	for (int p = 0; p < collisions.layerPairsCount; p++)
+	{
+		PairSearchJob job = { collisions.layerPairs[p][0], collisions.layerPairs[p][1] };
+		RunPairSearch(BruteForceFindPairsRange, &job, buckets.start[job.layer1 + 1] - buckets.start[job.layer1]);
+	}
+}
 
-	return Distance(pos1, pos2) < (radius1 + radius2);
+static void SapAdd(int idx)
+{
+	if (sap.endpointsCount + 2 > sap.endpointsCapacity)
+	{
+		sap.endpointsCapacity = sap.endpointsCapacity > 0 ? 2 * sap.endpointsCapacity : 2 * COLLIDERS_MIN_CAPACITY;
+		sap.endpoints = (SapEndpoint*)GrowArray(sap.endpoints, sizeof(SapEndpoint), sap.endpointsCapacity);
+	}
+	sap.endpoints[sap.endpointsCount].data = 0;
+	sap.endpoints[sap.endpointsCount++].cID = collisions.handles[idx];
+	sap.endpoints[sap.endpointsCount].data = SAP_MAX_ENDPOINT;
+	sap.endpoints[sap.endpointsCount++].cID = collisions.handles[idx];
+	sap.addedCount += 2;
 }
 
-static bool InCallbackQueue(ColliderData collider)
+// By value, the opening endpoint first on ties so a zero width interval opens before it closes
+static int CompareEndpoints(const void* a, const void* b)
 {
-	unsigned int bm = collisionCallback.callbackInQueueBm[collider.cID / 32];
-	return (bm & (1 << collider.cID % 32)) > 0;	
+	const SapEndpoint* endpoint1 = (const SapEndpoint*)a;
+	const SapEndpoint* endpoint2 = (const SapEndpoint*)b;
+	if (endpoint1->value != endpoint2->value) return endpoint1->value < endpoint2->value ? -1 : 1;
+	return (int)(endpoint1->data & SAP_MAX_ENDPOINT) - (int)(endpoint2->data & SAP_MAX_ENDPOINT);
 }
 
-static void AddToCallbackQueue(ColliderData collider1, ColliderData collider2)
+static void SapUpdate()
 {
-	CallbackData data = { collider1.collider->collisionCallback , collider1.collider, collider2.collider};
-	collisionCallback.queue[collisionCallback.count++] = data;
-	collisionCallback.callbackInQueueBm[collider1.cID / 32] |= 1U << (collider1.cID % 32);
-	assert(collisionCallback.count <= MAX_COLLIDERS);
-}
\ No newline at end of file
+	// Drop the endpoints of removed colliders, keeping the order, and refresh the indices and values
+	int kept = 0;
+	for (int e = 0; e < sap.endpointsCount; e++)
+	{
+		SapEndpoint endpoint = sap.endpoints[e];
+		int idx = ColliderIndex(endpoint.cID);
+		if (idx < 0) continue;
+		unsigned int maxEndpoint = endpoint.data & SAP_MAX_ENDPOINT;
+		endpoint.data = ((unsigned int)idx << 1) | maxEndpoint;
+		endpoint.value = maxEndpoint ? shapes.x[idx] + shapes.bounds[idx] : shapes.x[idx] - shapes.bounds[idx];
+		sap.endpoints[kept++] = endpoint;
+	}
+	sap.endpointsCount = kept;
+	assert(sap.endpointsCount == 2 * collisions.collidersCount);
+
+	// Every new endpoint can travel the whole list in the insertion sort, bulk adds are sorted from scratch
+	if (sap.addedCount > SAP_MAX_INSERTIONS)
+	{
+		qsort(sap.endpoints, sap.endpointsCount, sizeof(SapEndpoint), CompareEndpoints);
+		sap.addedCount = 0;
+		return;
+	}
+	sap.addedCount = 0;
+	for (int e = 1; e < sap.endpointsCount; e++)
+	{
+		SapEndpoint endpoint = sap.endpoints[e];
+		int k = e - 1;
+		while (k >= 0 && CompareEndpoints(&sap.endpoints[k], &endpoint) > 0)
+		{
+			sap.endpoints[k + 1] = sap.endpoints[k];
+			k--;
+		}
+		sap.endpoints[k + 1] = endpoint;
+	}
+}
+
+static void SapFindPairs()
+{
+	for (int l = 0; l < collisions.layerCount; l++)
+	{
+		sap.activeCount[l] = 0;
+	}
+	for (int e = 0; e < sap.endpointsCount; e++)
+	{
+		int idx = sap.endpoints[e].data >> 1;
+		int layer = collisions.layers[idx];
+		int* active = sap.active[layer];
+		if (sap.endpoints[e].data & SAP_MAX_ENDPOINT)
+		{
+			// Interval closed, swap-remove it from the active list of its layer
+			int pos = sap.activePos[idx];
+			int last = active[--sap.activeCount[layer]];
+			active[pos] = last;
+			sap.activePos[last] = pos;
+		}
+		else
+		{
+			// Every open interval overlaps this one on x, only check y before the narrowphase.
+			// Only the layers this one collides with are looked at.
+			float y = shapes.y[idx];
+			float radius = shapes.bounds[idx];
+			unsigned int mask = collisions.layerMasks[layer];
+			while (mask)
+			{
+				int otherLayer = LowestBitIndex(mask);
+				mask &= mask - 1;
+				for (int a = 0; a < sap.activeCount[otherLayer]; a++)
+				{
+					int other = sap.active[otherLayer][a];
+					if (fabsf(shapes.y[other] - y) > radius + shapes.bounds[other]) continue;
+					TestPair(&pairWorkers.workers[0], idx, other);
+				}
+			}
+			sap.activePos[idx] = sap.activeCount[layer];
+			active[sap.activeCount[layer]++] = idx;
+		}
+	}
+}
+
+static void TreeAdd(int idx)
+{
+	AABB aabb = AabbFromCircle(V2(shapes.x[idx], shapes.y[idx]), shapes.bounds[idx]);
+	tree.proxies[idx] = AabbTree_CreateProxy(&tree.trees[collisions.layers[idx]], aabb, idx);
+}
+
+static void TreeRemove(int idx, int last)
+{
+	AabbTree_DestroyProxy(&tree.trees[collisions.layers[idx]], tree.proxies[idx]);
+	if (idx != last) AabbTree_SetUserData(&tree.trees[collisions.layers[last]], tree.proxies[last], idx);
+}
+
+static void TreeUpdate()
+{
+	for (int i = 0; i < collisions.collidersCount; i++)
+	{
+		AABB aabb = AabbFromCircle(V2(shapes.x[i], shapes.y[i]), shapes.bounds[i]);
+		AabbTree_MoveProxy(&tree.trees[collisions.layers[i]], tree.proxies[i], aabb);
+	}
+	tree.dirty = false;
+}
+
+static void TreePairCallback(void* context, int idx1, int idx2)
+{
+	TestPair((PairWorker*)context, idx1, idx2);
+}
+
+static void TreeFindPairs()
+{
+	for (int p = 0; p < collisions.layerPairsCount; p++)
+	{
+		int layer1 = collisions.layerPairs[p][0];
+		int layer2 = collisions.layerPairs[p][1];
+		AabbTree_QueryPairs(&tree.trees[layer1], &tree.trees[layer2], TreePairCallback, &pairWorkers.workers[0]);
+	}
+}
+
+// Splits [0, count) over the worker pool, or runs it on this thread for small counts
+static void RunPairSearch(JobsRangeFunc func, void* context, int count)
+{
+	if (collisions.parallel && collisions.collidersCount >= PARALLEL_MIN_COLLIDERS)
+	{
+		Jobs_ParallelFor(count, PARALLEL_BATCH_SIZE, func, context);
+	}
+	else
+	{
+		func(context, 0, count, 0);
+	}
+}
+
+static void TestPair(PairWorker* worker, int idx1, int idx2)
+{
+	if (idx1 > idx2)
+	{
+		int tmp = idx1;
+		idx1 = idx2;
+		idx2 = tmp;
+	}
+
+	// The broadphases only visit enabled layer pairs, so the masks always allow this pair
+	assert(collisions.layerMasks[collisions.layers[idx1]] & COLLISION_LAYER_BIT(collisions.layers[idx2]));
+	worker->candidatePairs++;
+	int collisionType = collisions.types[idx1] | collisions.types[idx2];
+	switch (collisionType)
+	{
+	case COLLISION_CIRLE_CIRCLE:
+	{
+		// In a wrapping world a wrapping idx2 is tested at its image closest to a wrapping idx1 (minimum
+		// image convention)
+		float offsetX = 0.0f;
+		float offsetY = 0.0f;
+		if (collisions.wrap && collisions.wraps[idx1] && collisions.wraps[idx2])
+		{
+			offsetX = -collisions.wrapSize.x * roundf((shapes.x[idx2] - shapes.x[idx1]) / collisions.wrapSize.x);
+			offsetY = -collisions.wrapSize.y * roundf((shapes.y[idx2] - shapes.y[idx1]) / collisions.wrapSize.y);
+		}
+		if (collisions.speeds[idx1] >= 0.0f && collisions.speeds[idx2] >= 0.0f && SkipPair(worker, idx1, idx2, offsetX, offsetY)) break;
+		if (collisions.continuous[idx1] || collisions.continuous[idx2])
+		{
+			TestSweptPair(worker, idx1, idx2, offsetX, offsetY);
+			break;
+		}
+		NarrowphaseQueue* narrowphase = &worker->narrowphase;
+		CirclePairBatch* batch = &narrowphase->circles;
+		int n = batch->count++;
+		batch->x1[n] = shapes.x[idx1]; batch->y1[n] = shapes.y[idx1];
+		batch->x2[n] = shapes.x[idx2] + offsetX; batch->y2[n] = shapes.y[idx2] + offsetY;
+		batch->radiusSum[n] = shapes.radius[idx1] + shapes.radius[idx2];
+		narrowphase->idx1[n] = idx1;
+		narrowphase->idx2[n] = idx2;
+		if (batch->count == NARROWPHASE_BATCH_SIZE) FlushNarrowphase(worker);
+	} break;
+	case COLLISION_BOX_BOX:
+	case COLLISION_CIRCLE_BOX: // falling through on purpose until implemented...
+	InvalidDefaultCase;
+	}
+}
+
+static int ComparePairs(const void* a, const void* b)
+{
+	const CollisionPair* pair1 = (const CollisionPair*)a;
+	const CollisionPair* pair2 = (const CollisionPair*)b;
+	if (pair1->idx1 != pair2->idx1) return pair1->idx1 < pair2->idx1 ? -1 : 1;
+	if (pair1->idx2 != pair2->idx2) return pair1->idx2 < pair2->idx2 ? -1 : 1;
+	return 0;
+}
+
+static unsigned long long PairKey(CID cID1, CID cID2)
+{
+	return cID1 < cID2 ? ((unsigned long long)cID1 << 32) | cID2 : ((unsigned long long)cID2 << 32) | cID1;
+}
+
+// Entry holding key, or the empty entry where it would go
+static PairSkip* FindPairSkip(unsigned long long key)
+{
+	unsigned int mask = (unsigned int)pairSkips.capacity - 1;
+	unsigned int e = (unsigned int)((key * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+	while (pairSkips.entries[e].key != 0 && pairSkips.entries[e].key != key)
+	{
+		e = (e + 1) & mask;
+	}
+	return &pairSkips.entries[e];
+}
+
+// Conservative time of impact culling for two colliders with known speed bounds. The gap between them
+// can shrink by at most (speed1 + speed2) * deltaT per frame, so while it can't have closed the pair is
+// a sure miss and doesn't need the narrowphase. Returns true if the pair is a miss this frame.
+static bool SkipPair(PairWorker* worker, int idx1, int idx2, float offsetX, float offsetY)
+{
+	CID cID1 = collisions.handles[idx1];
+	CID cID2 = collisions.handles[idx2];
+	unsigned int epoch1 = collisions.speedEpochs[idx1];
+	unsigned int epoch2 = collisions.speedEpochs[idx2];
+	if (cID1 > cID2)
+	{
+		unsigned int tmp = epoch1;
+		epoch1 = epoch2;
+		epoch2 = tmp;
+	}
+	unsigned long long key = PairKey(cID1, cID2);
+	if (pairSkips.capacity > 0)
+	{
+		PairSkip* skip = FindPairSkip(key);
+		if (skip->key == key && skip->epoch1 == epoch1 && skip->epoch2 == epoch2 && pairSkips.frame < skip->retestFrame)
+		{
+			worker->pairsSkipped++;
+			return true;
+		}
+	}
+
+	float dx = shapes.x[idx2] + offsetX - shapes.x[idx1];
+	float dy = shapes.y[idx2] + offsetY - shapes.y[idx1];
+	float gap = sqrtf(dx * dx + dy * dy) - shapes.bounds[idx1] - shapes.bounds[idx2] - PAIR_SKIP_SLOP;
+	if (gap <= 0.0f) return false;
+	float closing = (collisions.speeds[idx1] + collisions.speeds[idx2]) * game.deltaT;
+	float frames = closing > 0.0f ? gap / closing : (float)PAIR_SKIP_MAX_FRAMES;
+	if (frames < 2.0f) return false; // could touch next frame, nothing to skip
+
+	if (worker->newSkipsCount == worker->newSkipsCapacity)
+	{
+		worker->newSkipsCapacity = worker->newSkipsCapacity > 0 ? 2 * worker->newSkipsCapacity : COLLIDERS_MIN_CAPACITY;
+		worker->newSkips = (PairSkip*)GrowArray(worker->newSkips, sizeof(PairSkip), worker->newSkipsCapacity);
+	}
+	PairSkip skip = { key, epoch1, epoch2, pairSkips.frame + (frames < PAIR_SKIP_MAX_FRAMES ? (unsigned int)frames : PAIR_SKIP_MAX_FRAMES) };
+	worker->newSkips[worker->newSkipsCount++] = skip;
+	worker->pairsSkipped++;
+	return true;
+}
+
+// Rebuilds the cache with only the entries still in use, growing it if they fill more than a quarter
+static void RehashPairSkips(int needed)
+{
+	int live = 0;
+	for (int e = 0; e < pairSkips.capacity; e++)
+	{
+		PairSkip skip = pairSkips.entries[e];
+		if (skip.key != 0 && pairSkips.frame < skip.retestFrame) pairSkips.scratch[live++] = skip;
+	}
+
+	int capacity = pairSkips.capacity > 0 ? pairSkips.capacity : COLLIDERS_MIN_CAPACITY;
+	while (capacity < 4 * (live + needed)) capacity *= 2;
+	if (capacity != pairSkips.capacity)
+	{
+		// scratch has the live entries, keep them while both arrays grow
+		PairSkip* scratch = (PairSkip*)GrowArray(NULL, sizeof(PairSkip), capacity);
+		memcpy(scratch, pairSkips.scratch, sizeof(PairSkip) * live);
+		free(pairSkips.scratch);
+		pairSkips.scratch = scratch;
+		pairSkips.entries = (PairSkip*)GrowArray(pairSkips.entries, sizeof(PairSkip), capacity);
+		pairSkips.capacity = capacity;
+	}
+	memset(pairSkips.entries, 0, sizeof(PairSkip) * pairSkips.capacity);
+	for (int i = 0; i < live; i++)
+	{
+		*FindPairSkip(pairSkips.scratch[i].key) = pairSkips.scratch[i];
+	}
+	pairSkips.count = live;
+}
+
+// Moves the skips the workers found into the cache
+static void StorePairSkips()
+{
+	int newCount = 0;
+	for (int t = 0; t < pairWorkers.count; t++)
+	{
+		newCount += pairWorkers.workers[t].newSkipsCount;
+	}
+	if (newCount == 0) return;
+	if (2 * (pairSkips.count + newCount) > pairSkips.capacity) RehashPairSkips(newCount);
+
+	for (int t = 0; t < pairWorkers.count; t++)
+	{
+		PairWorker* worker = &pairWorkers.workers[t];
+		for (int i = 0; i < worker->newSkipsCount; i++)
+		{
+			PairSkip* skip = FindPairSkip(worker->newSkips[i].key);
+			if (skip->key == 0) pairSkips.count++;
+			*skip = worker->newSkips[i];
+		}
+	}
+}
+
+// Time in [0, 1] at which two circles moving in a straight line over the frame first touch, -1 if they
+// don't. (sx, sy) is the offset between the centers at the start of the frame, (vx, vy) how much it
+// changes until the end.
+static float SweptCircleTOI(float sx, float sy, float vx, float vy, float radiusSum)
+{
+	float c = sx * sx + sy * sy - radiusSum * radiusSum;
+	if (c < 0.0f) return 0.0f; // already touching at the start
+	float a = vx * vx + vy * vy;
+	float halfB = sx * vx + sy * vy;
+	if (halfB >= 0.0f || a == 0.0f) return -1.0f; // not getting closer
+	float discriminant = halfB * halfB - a * c;
+	if (discriminant < 0.0f) return -1.0f;
+	float t = c / (sqrtf(discriminant) - halfB); // first root, written so it doesn't cancel
+	return t <= 1.0f ? t : -1.0f;
+}
+
+// Scalar swept test for the pairs with a continuous collider, goes straight to the hits. The other
+// collider, if it isn't continuous too, is taken where it is at the end of the frame: its bounds don't
+// cover its path, so the broadphases wouldn't find the pairs it only touches on the way.
+static void TestSweptPair(PairWorker* worker, int idx1, int idx2, float offsetX, float offsetY)
+{
+	float prevX1 = collisions.continuous[idx1] ? shapes.prevX[idx1] : shapes.x[idx1];
+	float prevY1 = collisions.continuous[idx1] ? shapes.prevY[idx1] : shapes.y[idx1];
+	float prevX2 = collisions.continuous[idx2] ? shapes.prevX[idx2] : shapes.x[idx2];
+	float prevY2 = collisions.continuous[idx2] ? shapes.prevY[idx2] : shapes.y[idx2];
+	float sx = prevX2 + offsetX - prevX1;
+	float sy = prevY2 + offsetY - prevY1;
+	float vx = (shapes.x[idx2] - prevX2) - (shapes.x[idx1] - prevX1);
+	float vy = (shapes.y[idx2] - prevY2) - (shapes.y[idx1] - prevY1);
+	worker->narrowphaseTests++;
+	if (SweptCircleTOI(sx, sy, vx, vy, shapes.radius[idx1] + shapes.radius[idx2]) >= 0.0f) AddHit(&worker->hits, idx1, idx2);
+}
+
+static void AddHit(CollisionPairs* hits, int idx1, int idx2)
+{
+	if (hits->count == hits->capacity)
+	{
+		hits->capacity = hits->capacity > 0 ? 2 * hits->capacity : COLLIDERS_MIN_CAPACITY;
+		hits->pairs = (CollisionPair*)GrowArray(hits->pairs, sizeof(CollisionPair), hits->capacity);
+	}
+	CollisionPair pair = { idx1, idx2 };
+	hits->pairs[hits->count++] = pair;
+}
+
+static void FlushNarrowphase(PairWorker* worker)
+{
+	NarrowphaseQueue* narrowphase = &worker->narrowphase;
+	CirclePairBatch* batch = &narrowphase->circles;
+	CollisionPairs* hits = &worker->hits;
+	worker->narrowphaseTests += batch->count;
+	Narrowphase_CircleCircle(batch->x1, batch->y1, batch->x2, batch->y2, batch->radiusSum, batch->count, narrowphase->hitMask);
+	for (int w = 0; w < (batch->count + 31) / 32; w++)
+	{
+		unsigned int bits = narrowphase->hitMask[w];
+		while (bits)
+		{
+			int n = w * 32 + LowestBitIndex(bits);
+			bits &= bits - 1;
+			AddHit(hits, narrowphase->idx1[n], narrowphase->idx2[n]);
+		}
+	}
+	batch->count = 0;
+}
+
+// Gathers the hits of every worker in collisionPairs
+static void MergeHits()
+{
+	int count = 0;
+	for (int t = 0; t < pairWorkers.count; t++)
+	{
+		count += pairWorkers.workers[t].hits.count;
+	}
+	if (count > collisionPairs.capacity)
+	{
+		collisionPairs.capacity = count;
+		collisionPairs.pairs = (CollisionPair*)GrowArray(collisionPairs.pairs, sizeof(CollisionPair), collisionPairs.capacity);
+	}
+	collisionPairs.count = 0;
+	for (int t = 0; t < pairWorkers.count; t++)
+	{
+		CollisionPairs* hits = &pairWorkers.workers[t].hits;
+		if (hits->count > 0) memcpy(&collisionPairs.pairs[collisionPairs.count], hits->pairs, sizeof(CollisionPair) * hits->count);
+		collisionPairs.count += hits->count;
+	}
+}
+
+// Queues the event unless the collider isn't listening to its phase or already has one, a collider gets
+// one enter or stay and one exit per frame at most. Events go in a queue instead of straight to the
+// callbacks since those usually destroy things.
+static void QueueEvent(CID cID, CID otherCID, Collider* otherCollider, int pairType, CollisionPhase phase)
+{
+	int idx = ColliderIndex(cID);
+	if (idx < 0) return; // removed since the last frame, no exit for it
+	unsigned int phases = pairDispatch.handlers[pairType] ? pairDispatch.phases[pairType] : COLLISION_ENTER | COLLISION_STAY;
+	if (!(phases & phase)) return;
+
+	int bitmap = (phase == COLLISION_EXIT ? 1 : 0) * ((collisions.capacity + 31) / 32);
+	unsigned int* bm = &collisionCallback.callbackInQueueBm[bitmap + idx / 32];
+	if (*bm & (1U << (idx % 32))) return;
+	*bm |= 1U << (idx % 32);
+
+	CollisionEvent event = { cID, otherCID, otherCollider, phase };
+	collisionCallback.ranks[collisionCallback.count] = pairDispatch.rank[pairType];
+	collisionCallback.queue[collisionCallback.count++] = event;
+	assert(collisionCallback.count <= QUEUED_PHASES * collisions.collidersCount);
+}
+
+static unsigned long long PairKey(CID cID1, CID cID2);
+
+static int FindContact(unsigned long long key)
+{
+	if (contactCache.tableCapacity == 0) return -1;
+	unsigned int mask = (unsigned int)contactCache.tableCapacity - 1;
+	unsigned int e = (unsigned int)((key * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+	while (contactCache.table[e] != -1)
+	{
+		if (contactCache.contacts[contactCache.table[e]].key == key) return contactCache.table[e];
+		e = (e + 1) & mask;
+	}
+	return -1;
+}
+
+// Turns the sorted hits into enter and stay events, the contacts of last frame no hit touched into exit
+// events, and keeps the hits as the contacts for the next frame
+static void QueueContactEvents()
+{
+	collisionCallback.count = 0;
+	memset(collisionCallback.callbackInQueueBm, 0, sizeof(unsigned int) * QUEUED_PHASES * ((collisions.capacity + 31) / 32));
+	if (collisionPairs.count > contactCache.capacity || contactCache.capacity == 0)
+	{
+		int capacity = contactCache.capacity > 0 ? 2 * contactCache.capacity : COLLIDERS_MIN_CAPACITY;
+		contactCache.capacity = collisionPairs.count > capacity ? collisionPairs.count : capacity;
+		contactCache.contacts = (Contact*)GrowArray(contactCache.contacts, sizeof(Contact), contactCache.capacity);
+		contactCache.next = (Contact*)GrowArray(contactCache.next, sizeof(Contact), contactCache.capacity);
+	}
+	contactCache.nextCount = 0;
+
+	for (int i = 0; i < collisionPairs.count; i++)
+	{
+		int idx1 = collisionPairs.pairs[i].idx1;
+		int idx2 = collisionPairs.pairs[i].idx2;
+		Contact contact = { PairKey(collisions.handles[idx1], collisions.handles[idx2]), collisions.handles[idx1], collisions.handles[idx2],
+							collisions.entityTypes[idx1], collisions.entityTypes[idx2], false };
+		int previous = FindContact(contact.key);
+		CollisionPhase phase = previous >= 0 ? COLLISION_STAY : COLLISION_ENTER;
+		if (previous >= 0) contactCache.contacts[previous].touching = true;
+		contactCache.next[contactCache.nextCount++] = contact;
+
+		QueueEvent(contact.cID1, contact.cID2, collisions.colliders[idx2], contact.entityType1 * MAX_COLLISION_ENTITY_TYPES + contact.entityType2, phase);
+		QueueEvent(contact.cID2, contact.cID1, collisions.colliders[idx1], contact.entityType2 * MAX_COLLISION_ENTITY_TYPES + contact.entityType1, phase);
+	}
+	for (int c = 0; c < contactCache.count; c++)
+	{
+		Contact contact = contactCache.contacts[c];
+		if (contact.touching) continue;
+		QueueEvent(contact.cID1, contact.cID2, Collisions_GetCollider(contact.cID2), contact.entityType1 * MAX_COLLISION_ENTITY_TYPES + contact.entityType2, COLLISION_EXIT);
+		QueueEvent(contact.cID2, contact.cID1, Collisions_GetCollider(contact.cID1), contact.entityType2 * MAX_COLLISION_ENTITY_TYPES + contact.entityType1, COLLISION_EXIT);
+	}
+
+	// This frame's hits become the contacts, the old array takes the next frame's
+	Contact* contacts = contactCache.contacts;
+	contactCache.contacts = contactCache.next;
+	contactCache.next = contacts;
+	contactCache.count = contactCache.nextCount;
+	int tableCapacity = contactCache.tableCapacity > 0 ? contactCache.tableCapacity : COLLIDERS_MIN_CAPACITY;
+	while (tableCapacity < 2 * contactCache.count) tableCapacity *= 2;
+	if (tableCapacity != contactCache.tableCapacity)
+	{
+		contactCache.table = (int*)GrowArray(contactCache.table, sizeof(int), tableCapacity);
+		contactCache.tableCapacity = tableCapacity;
+	}
+	memset(contactCache.table, 0xff, sizeof(int) * contactCache.tableCapacity);
+	unsigned int mask = (unsigned int)contactCache.tableCapacity - 1;
+	for (int c = 0; c < contactCache.count; c++)
+	{
+		unsigned int e = (unsigned int)((contactCache.contacts[c].key * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+		while (contactCache.table[e] != -1)
+		{
+			e = (e + 1) & mask;
+		}
+		contactCache.table[e] = c;
+	}
+}
+
+// Runs the queued events bucketed by pair type, each handler once over its whole bucket. The buckets
+// keep the queue order, so the dispatch stays deterministic. Colliders removed by an earlier callback
+// don't get theirs.
+static void DispatchCallbacks()
+{
+	int count = collisionCallback.count;
+	if (count > collisionCallback.sortedCapacity)
+	{
+		collisionCallback.sortedCapacity = QUEUED_PHASES * collisions.capacity;
+		collisionCallback.sorted = (CollisionEvent*)GrowArray(collisionCallback.sorted, sizeof(CollisionEvent), collisionCallback.sortedCapacity);
+	}
+
+	int start[PAIR_RANKS + 1] = {};
+	for (int i = 0; i < count; i++)
+	{
+		start[collisionCallback.ranks[i] + 1]++;
+	}
+	for (int r = 0; r < PAIR_RANKS; r++)
+	{
+		start[r + 1] += start[r];
+	}
+	int fill[PAIR_RANKS];
+	memcpy(fill, start, sizeof(fill));
+	for (int i = 0; i < count; i++)
+	{
+		collisionCallback.sorted[fill[collisionCallback.ranks[i]]++] = collisionCallback.queue[i];
+	}
+
+	for (int r = 0; r < PAIR_RANKS; r++)
+	{
+		if (start[r] == start[r + 1]) continue;
+		const CollisionEvent* events = &collisionCallback.sorted[start[r]];
+		int eventCount = start[r + 1] - start[r];
+		CollisionPairHandler handler = pairDispatch.handlers[pairDispatch.pairType[r]];
+		if (handler)
+		{
+			handler(events, eventCount);
+			continue;
+		}
+		for (int i = 0; i < eventCount; i++)
+		{
+			Collider* collider;
+			Collider* otherCollider;
+			if (!Collisions_ResolveEvent(&events[i], &collider, &otherCollider)) continue;
+			if (collider->collisionCallback) (*collider->collisionCallback)(collider, otherCollider);
+		}
+	}
+}
+
+static unsigned int QueryLayers(unsigned int layerMask)
+{
+	unsigned int layers = collisions.layerCount == 32 ? 0xffffffffU : COLLISION_LAYER_BIT(collisions.layerCount) - 1;
+	return layerMask & layers;
+}
+
+static int* ReserveQueryScratch(int count)
+{
+	if (count > queryScratch.capacity)
+	{
+		queryScratch.capacity = count > 2 * queryScratch.capacity ? count : 2 * queryScratch.capacity;
+		queryScratch.indices = (int*)GrowArray(queryScratch.indices, sizeof(int), queryScratch.capacity);
+	}
+	return queryScratch.indices;
+}
+
+static void TreeEnsureUpdated()
+{
+	if (tree.dirty) TreeUpdate();
+}
+
+static bool CircleOverlaps(int idx, Vector2 center, float radius)
+{
+	float dx = shapes.x[idx] - center.x;
+	float dy = shapes.y[idx] - center.y;
+	float radiusSum = radius + shapes.radius[idx];
+	return dx * dx + dy * dy < radiusSum * radiusSum;
+}
+
+static int TreeQueryCircle(Vector2 center, float radius, unsigned int layerMask, CID* results, int maxResults)
+{
+	TreeEnsureUpdated();
+	AABB aabb = AabbFromCircle(center, radius);
+	int count = 0;
+	unsigned int mask = QueryLayers(layerMask);
+	while (mask)
+	{
+		int layer = LowestBitIndex(mask);
+		mask &= mask - 1;
+		int leafCount = AabbTree_QueryOverlap(&tree.trees[layer], aabb, queryScratch.indices, queryScratch.capacity);
+		if (leafCount > queryScratch.capacity)
+		{
+			AabbTree_QueryOverlap(&tree.trees[layer], aabb, ReserveQueryScratch(leafCount), leafCount);
+		}
+		for (int n = 0; n < leafCount; n++)
+		{
+			int i = queryScratch.indices[n];
+			if (!CircleOverlaps(i, center, radius)) continue;
+			if (count < maxResults) results[count] = collisions.handles[i];
+			count++;
+		}
+	}
+	return count;
+}
+
+int Collisions_QueryCircle(Vector2 center, float radius, unsigned int layerMask, CID* results, int maxResults)
+{
+	if (collisions.broadphase == BROADPHASE_TREE) return TreeQueryCircle(center, radius, layerMask, results, maxResults);
+	GridEnsureBuilt();
+
+	// Colliders are binned by center, so look as far as the largest one could reach
+	float reach = radius + grid.maxRadius;
+	int x0 = GridCoord(center.x - reach, grid.origin.x, grid.cellsX);
+	int x1 = GridCoord(center.x + reach, grid.origin.x, grid.cellsX);
+	int y0 = GridCoord(center.y - reach, grid.origin.y, grid.cellsY);
+	int y1 = GridCoord(center.y + reach, grid.origin.y, grid.cellsY);
+
+	int count = 0;
+	unsigned int mask = QueryLayers(layerMask);
+	while (mask)
+	{
+		int layer = LowestBitIndex(mask);
+		mask &= mask - 1;
+		int* cellStart = &grid.cellStart[layer * grid.cellCount];
+		for (int y = y0; y <= y1; y++)
+		{
+			for (int x = x0; x <= x1; x++)
+			{
+				int cell = y * grid.cellsX + x;
+				for (int k = cellStart[cell]; k < cellStart[cell + 1]; k++)
+				{
+					int i = grid.cellColliders[k];
+					if (!CircleOverlaps(i, center, radius)) continue;
+					if (count < maxResults) results[count] = collisions.handles[i];
+					count++;
+				}
+			}
+		}
+	}
+	return count;
+}
+
+// Clips the ray interval [*tMin, *tMax] to the box, false if nothing is left
+static bool ClipRay(Vector2 origin, Vector2 dir, AABB box, float* tMin, float* tMax)
+{
+	float o[2] = { origin.x, origin.y };
+	float d[2] = { dir.x, dir.y };
+	float boxMin[2] = { box.min.x, box.min.y };
+	float boxMax[2] = { box.max.x, box.max.y };
+	for (int axis = 0; axis < 2; axis++)
+	{
+		if (fabsf(d[axis]) < 1e-8f)
+		{
+			if (o[axis] < boxMin[axis] || o[axis] > boxMax[axis]) return false;
+			continue;
+		}
+		float t1 = (boxMin[axis] - o[axis]) / d[axis];
+		float t2 = (boxMax[axis] - o[axis]) / d[axis];
+		if (t1 > t2) { float tmp = t1; t1 = t2; t2 = tmp; }
+		if (t1 > *tMin) *tMin = t1;
+		if (t2 < *tMax) *tMax = t2;
+		if (*tMin > *tMax) return false;
+	}
+	return true;
+}
+
+// Distance along the (normalized) ray to where it enters the circle, 0 if it starts inside
+static bool RayCircle(Vector2 origin, Vector2 dir, float cx, float cy, float radius, float* t)
+{
+	float mx = cx - origin.x;
+	float my = cy - origin.y;
+	if (mx * mx + my * my < radius * radius)
+	{
+		*t = 0.0f;
+		return true;
+	}
+	// Distance to the closest point and from there to the circle, the cross product keeps long rays precise
+	float along = mx * dir.x + my * dir.y;
+	float across = mx * dir.y - my * dir.x;
+	float halfChordSq = radius * radius - across * across;
+	if (along < 0.0f || halfChordSq < 0.0f) return false;
+	*t = along - sqrtf(halfChordSq);
+	return true;
+}
+
+// Closest collider hit along the normalized ray, -1 for none. *bestT starts at maxDistance
+static int GridRaycast(Vector2 origin, Vector2 dir, float maxDistance, unsigned int layerMask, float* bestT)
+{
+	GridEnsureBuilt();
+	float tMin = 0.0f;
+	float tMax = maxDistance;
+	if (!ClipRay(origin, dir, grid.bounds, &tMin, &tMax)) return -1;
+
+	// Walk the ray one cell length at a time, looking at the cells that colliders touching that piece
+	// of the ray can be binned in. A collider the ray enters inside a piece is always found with that
+	// piece, so the walk stops once the closest hit so far lies within the pieces walked.
+	unsigned int layers = QueryLayers(layerMask);
+	int best = -1;
+	int steps = (int)ceilf((tMax - tMin) / grid.cellSize);
+	if (steps < 1) steps = 1;
+	for (int step = 0; step < steps; step++)
+	{
+		float t0 = tMin + step * grid.cellSize;
+		float t1 = t0 + grid.cellSize < tMax ? t0 + grid.cellSize : tMax;
+		Vector2 p0 = origin + t0 * dir;
+		Vector2 p1 = origin + t1 * dir;
+		float reach = grid.maxRadius;
+		int x0 = GridCoord((p0.x < p1.x ? p0.x : p1.x) - reach, grid.origin.x, grid.cellsX);
+		int x1 = GridCoord((p0.x > p1.x ? p0.x : p1.x) + reach, grid.origin.x, grid.cellsX);
+		int y0 = GridCoord((p0.y < p1.y ? p0.y : p1.y) - reach, grid.origin.y, grid.cellsY);
+		int y1 = GridCoord((p0.y > p1.y ? p0.y : p1.y) + reach, grid.origin.y, grid.cellsY);
+
+		unsigned int mask = layers;
+		while (mask)
+		{
+			int layer = LowestBitIndex(mask);
+			mask &= mask - 1;
+			int* cellStart = &grid.cellStart[layer * grid.cellCount];
+			for (int y = y0; y <= y1; y++)
+			{
+				for (int x = x0; x <= x1; x++)
+				{
+					int cell = y * grid.cellsX + x;
+					for (int k = cellStart[cell]; k < cellStart[cell + 1]; k++)
+					{
+						int i = grid.cellColliders[k];
+						float t;
+						if (!RayCircle(origin, dir, shapes.x[i], shapes.y[i], shapes.radius[i], &t)) continue;
+						if (t > *bestT || (t == *bestT && best != -1 && i > best)) continue;
+						best = i;
+						*bestT = t;
+					}
+				}
+			}
+		}
+		if (best != -1 && *bestT <= t1) break;
+	}
+	return best;
+}
+
+// Closest hit so far of a raycast through the trees, the lowest index on ties like the grid walk
+struct TreeRaycastBest
+{
+	Vector2 origin;
+	Vector2 dir;
+	float length;
+	int best;
+	float bestT;
+};
+
+static float TreeRaycastCallback(void* context, int idx, Vector2 p1, Vector2 p2, float maxFraction)
+{
+	TreeRaycastBest* cast = (TreeRaycastBest*)context;
+	float t;
+	if (!RayCircle(cast->origin, cast->dir, shapes.x[idx], shapes.y[idx], shapes.radius[idx], &t)) return maxFraction;
+	if (t > cast->bestT || (t == cast->bestT && cast->best != -1 && idx > cast->best)) return maxFraction;
+	cast->best = idx;
+	cast->bestT = t;
+	// Keep the fraction above 0, which would stop the cast before a tie at the origin is seen
+	float fraction = t / cast->length;
+	return fraction > FLT_MIN ? fraction : FLT_MIN;
+}
+
+// Like GridRaycast
+static int TreeRaycast(Vector2 origin, Vector2 dir, float maxDistance, unsigned int layerMask, float* bestT)
+{
+	TreeEnsureUpdated();
+	// A zero length segment is skipped by the tree, cast a unit one to still report colliders around the origin
+	float length = maxDistance > 0.0f ? maxDistance : 1.0f;
+	TreeRaycastBest cast = { origin, dir, length, -1, maxDistance };
+	unsigned int mask = QueryLayers(layerMask);
+	while (mask)
+	{
+		int layer = LowestBitIndex(mask);
+		mask &= mask - 1;
+		AabbTree_Raycast(&tree.trees[layer], origin, origin + length * dir, TreeRaycastCallback, &cast);
+	}
+	*bestT = cast.bestT;
+	return cast.best;
+}
+
+bool Collisions_Raycast(Vector2 origin, Vector2 dir, float maxDistance, unsigned int layerMask, RaycastHit* hit)
+{
+	if (collisions.collidersCount == 0) return false;
+	if (Dot(dir, dir) == 0.0f || maxDistance < 0.0f) return false;
+	dir = Normalize(dir);
+
+	int best = -1;
+	float bestT = maxDistance;
+	if (collisions.broadphase == BROADPHASE_TREE)
+	{
+		best = TreeRaycast(origin, dir, maxDistance, layerMask, &bestT);
+	}
+	else
+	{
+		best = GridRaycast(origin, dir, maxDistance, layerMask, &bestT);
+	}
+	if (best == -1) return false;
+
+	hit->cID = collisions.handles[best];
+	hit->distance = bestT;
+	hit->point = origin + bestT * dir;
+	hit->normal = bestT > 0.0f ? Normalize(hit->point - V2(shapes.x[best], shapes.y[best])) : -1.0f * dir;
+	return true;
+}
+
+static float DistanceSqTo(int idx, Vector2 point)
+{
+	float dx = shapes.x[idx] - point.x;
+	float dy = shapes.y[idx] - point.y;
+	return dx * dx + dy * dy;
+}
+
+// Keeps nearest[0..*count) sorted by distance, at most k entries
+static void NearestInsert(int* nearest, int* count, int k, int idx, Vector2 point)
+{
+	float distanceSq = DistanceSqTo(idx, point);
+	int n = *count;
+	if (n == k)
+	{
+		if (distanceSq >= DistanceSqTo(nearest[k - 1], point)) return;
+		n--;
+	}
+	while (n > 0 && DistanceSqTo(nearest[n - 1], point) > distanceSq)
+	{
+		nearest[n] = nearest[n - 1];
+		n--;
+	}
+	nearest[n] = idx;
+	if (*count < k) (*count)++;
+}
+
+int Collisions_Nearest(Vector2 point, int k, unsigned int layerMask, CID* results)
+{
+	GridEnsureBuilt();
+	if (k <= 0) return 0;
+
+	// Dense indices while searching, turned into handles at the end
+	int* nearest = ReserveQueryScratch(k);
+	int count = 0;
+	unsigned int layers = QueryLayers(layerMask);
+
+	// Look at rings of cells around the cell of the point, until the ones left can't be closer
+	int cx = GridCoord(point.x, grid.origin.x, grid.cellsX);
+	int cy = GridCoord(point.y, grid.origin.y, grid.cellsY);
+	for (int ring = 0; ; ring++)
+	{
+		int x0 = cx - ring;
+		int x1 = cx + ring;
+		int y0 = cy - ring;
+		int y1 = cy + ring;
+		for (int y = y0; y <= y1; y++)
+		{
+			if (y < 0 || y >= grid.cellsY) continue;
+			int xStep = (y == y0 || y == y1) ? 1 : x1 - x0;
+			for (int x = x0; x <= x1; x += xStep)
+			{
+				if (x < 0 || x >= grid.cellsX) continue;
+				int cell = y * grid.cellsX + x;
+				unsigned int mask = layers;
+				while (mask)
+				{
+					int layer = LowestBitIndex(mask);
+					mask &= mask - 1;
+					int* cellStart = &grid.cellStart[layer * grid.cellCount];
+					for (int c = cellStart[cell]; c < cellStart[cell + 1]; c++)
+					{
+						NearestInsert(nearest, &count, k, grid.cellColliders[c], point);
+					}
+				}
+			}
+		}
+
+		// Colliders not seen yet are binned outside the rings looked at. A side of the rings that
+		// reached the grid border has nothing beyond it (outside colliders are clamped into the border cells).
+		bool leftDone = x0 <= 0;
+		bool rightDone = x1 >= grid.cellsX - 1;
+		bool bottomDone = y0 <= 0;
+		bool topDone = y1 >= grid.cellsY - 1;
+		if (leftDone && rightDone && bottomDone && topDone) break;
+		if (count == k)
+		{
+			float bound = FLT_MAX;
+			if (!leftDone)   bound = fminf(bound, point.x - (grid.origin.x + x0 * grid.cellSize));
+			if (!rightDone)  bound = fminf(bound, grid.origin.x + (x1 + 1) * grid.cellSize - point.x);
+			if (!bottomDone) bound = fminf(bound, point.y - (grid.origin.y + y0 * grid.cellSize));
+			if (!topDone)    bound = fminf(bound, grid.origin.y + (y1 + 1) * grid.cellSize - point.y);
+			if (bound * bound >= DistanceSqTo(nearest[count - 1], point)) break;
+		}
+	}
+
+	for (int n = 0; n < count; n++)
+	{
+		results[n] = collisions.handles[nearest[n]];
+	}
+	return count;
+}
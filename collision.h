@@ -5,6 +5,21 @@
 #include "guid.h"
 
 
+#define MAX_COLLISION_LAYERS		32
+#define COLLISION_LAYER_BIT(layer)	(1U << (layer))
+
+// Collider ID: handle returned by Collisions_AddCollider. The low bits are a slot index, the high bits
+// a generation that changes when the collider is removed, so a handle kept after removal can be detected.
+// A slot whose generation runs out (CID_MAX_GENERATION reuses) is retired rather than wrapped around.
+typedef unsigned int CID;
+#define CID_INDEX_BITS				24
+#define CID_INDEX(cID)				((cID) & ((1U << CID_INDEX_BITS) - 1))
+#define CID_GENERATION(cID)			((cID) >> CID_INDEX_BITS)
+#define CID_MAX_GENERATION			((1U << (32 - CID_INDEX_BITS)) - 1) // of retired slots, never given out
+#define INVALID_CID					0xffffffffU
+
+#define MAX_COLLISION_ENTITY_TYPES	8
+
 enum ColliderType
 {
 	COLLIDER_CIRCLE =	0x1 << 0,
@@ -16,8 +31,11 @@ struct Collider
 {
 	ColliderType colliderType;
 	GUID guid;
-	Vector2* posRef;
-	int layer;
+	CID cID; // set by Collisions_AddCollider
+	int layer; // [0, MAX_COLLISION_LAYERS)
+	int entityType; // [0, MAX_COLLISION_ENTITY_TYPES), picks the pair handler (see Collisions_SetPairHandler)
+	bool continuous; // swept test along the path since the last Collisions_CheckCollisions, for small fast colliders
+	bool wrap; // touches the other wrapping colliders across the screen edges, see Collisions_SetWrap
 	union
 	{
 		struct
@@ -30,12 +48,119 @@ struct Collider
 			Rect localRect;
 		} box;
 	};
-	void (*collisionCallback)(Collider*, Collider*);
+	void (*collisionCallback)(Collider*, Collider*); // used when no pair handler is set, can be NULL
+};
+
+// When a pair of colliders is touching, relative to the last Collisions_CheckCollisions
+enum CollisionPhase
+{
+	COLLISION_ENTER	= 0x1 << 0,	// started touching this frame
+	COLLISION_STAY	= 0x1 << 1,	// touching this frame and the last one
+	COLLISION_EXIT	= 0x1 << 2,	// touching the last frame but not this one, or the other collider was removed
+};
+
+// One queued hit, seen from the collider getting it. Handlers can remove colliders and move their owners,
+// so events keep handles, use Collisions_ResolveEvent to get the colliders.
+struct CollisionEvent
+{
+	CID cID;
+	CID otherCID;
+	Collider* otherCollider; // only used if the other collider was removed by then, NULL for an exit from a removed collider
+	CollisionPhase phase;
+};
+
+// Gets the hits of every collider of type typeA that touched one of type typeB this frame, in one batch
+typedef void (*CollisionPairHandler)(const CollisionEvent* events, int count);
+
+enum BroadphaseType
+{
+	BROADPHASE_BRUTE_FORCE = 0,	// test every pair
+	BROADPHASE_GRID,			// uniform grid over game.screenRect, rebuilt every frame
+	BROADPHASE_SAP,				// sweep and prune on x, endpoints kept sorted across frames
+	BROADPHASE_TREE,			// dynamic AABB tree per layer, one proxy per registered collider
 };
 
-void Collisions_Init(int collisionMatrix[][3], int collisionLayers);
-void Collisions_Clear();
+// layerMasks[i] has COLLISION_LAYER_BIT(j) set if layer i collides with layer j. The masks are made
+// symmetric, enabling i->j also enables j->i.
+// With parallel set, the brute force and grid pair searches are split over the Jobs worker pool (see
+// jobs.h) once there are enough colliders. Callbacks run in the same order as in a serial run.
+void Collisions_Init(const unsigned int layerMasks[], int collisionLayers, BroadphaseType broadphase = BROADPHASE_GRID, bool parallel = false);
+void Collisions_Clear(); // removes every collider
+// Makes game.screenRect a torus for the colliders with wrap set: two of them touch across opposite edges,
+// measured to the closest image of each other. Any other pair is tested where the colliders are. Only for
+// the brute force and grid broadphases. The spatial queries don't look across edges.
+void Collisions_SetWrap(bool wrap);
 void Collisions_NewFrame();
-void Collisions_AddCollider(Collider* collider);
+
+// Colliders are registered once and stay until removed. The collision system keeps its own copy of the
+// shape (position, radius, layer), the owner only sends it the new position after moving.
+CID Collisions_AddCollider(Collider* collider, Vector2 pos);
+void Collisions_RemoveCollider(CID cID);
+void Collisions_SetPosition(CID cID, Vector2 pos);
+void Collisions_Teleport(CID cID, Vector2 pos); // SetPosition without a path from the old position (wrap around, respawn)
+// Optional bound on how fast the collider moves, |vel| units per second until the next call. Once both
+// colliders of a pair have one, a pair too far apart to touch within the next frames is skipped until
+// it could. Raising the speed, or moving further in a frame than it allows (teleports, wrap around),
+// drops the skips of the collider, lowering it keeps them.
+void Collisions_SetVelocity(CID cID, Vector2 vel);
+void Collisions_SetColliderRef(CID cID, Collider* collider); // call after moving the Collider struct in memory
+Collider* Collisions_GetCollider(CID cID); // NULL if the collider was removed
+
+// Hits are dispatched grouped by (entityType of the collider, entityType of the other collider). Pair
+// types with a handler run first, in the order the handlers were set, then the colliders of the other
+// pair types get their collisionCallback. Collisions_Init removes every handler.
+// phases is a mask of CollisionPhases the handler gets, events of the others are dropped. The
+// collisionCallback of colliders without a handler gets enter and stay, so every frame they touch.
+void Collisions_SetPairHandler(int typeA, int typeB, CollisionPairHandler handler, unsigned int phases = COLLISION_ENTER | COLLISION_STAY);
+// False if the collider of the event was removed by an earlier handler, the event must be skipped then
+bool Collisions_ResolveEvent(const CollisionEvent* event, Collider** collider, Collider** otherCollider);
 void Collisions_CheckCollisions();
-void Collisions_DebugShowColliders();
\ No newline at end of file
+void Collisions_DebugShowColliders();
+// Shades the broadphase grid cells by how many colliders they hold, from blue for one to red for the
+// fullest cell. Any broadphase, the grid is the one the spatial queries use.
+void Collisions_DebugShowGrid();
+
+enum CollisionStage
+{
+	COLLISION_STAGE_BUCKETS = 0,		// bucketing the colliders by layer
+	COLLISION_STAGE_BROADPHASE_UPDATE,	// grid build, SAP sort, tree refit
+	COLLISION_STAGE_PAIR_SEARCH,		// broadphase pairs + batched narrowphase
+	COLLISION_STAGE_MERGE,				// merging and sorting the hits, filling the callback queue
+	COLLISION_STAGE_CALLBACKS,
+	COLLISION_STAGE_COUNT,
+};
+
+// Counters of the last Collisions_CheckCollisions
+struct CollisionStats
+{
+	int colliders;
+	int candidatePairs;		// pairs the broadphase found, pairsSkipped + narrowphaseTests
+	int pairsSkipped;		// candidates too far apart to touch for a while (see Collisions_SetVelocity)
+	int narrowphaseTests;
+	int hits;
+	int callbacks;			// events dispatched
+	float milliseconds;		// of the whole Collisions_CheckCollisions
+	unsigned long long cycles[COLLISION_STAGE_COUNT];
+};
+const CollisionStats* Collisions_GetStats();
+
+// Spatial queries over the registered colliders of the layers in layerMask (COLLISION_LAYER_BITs).
+// With BROADPHASE_TREE the circle and ray queries walk the AABB trees, everything else uses the uniform
+// grid, which is built for the queries whatever the broadphase. Either is refreshed first if colliders
+// moved since. Results go into the caller's buffers, only a scratch buffer grows to the largest query.
+struct RaycastHit
+{
+	CID cID;
+	Vector2 point;
+	Vector2 normal;
+	float distance;
+};
+
+// Colliders overlapping the circle, in no particular order. Returns the number of overlaps, which can
+// be larger than maxResults.
+int Collisions_QueryCircle(Vector2 center, float radius, unsigned int layerMask, CID* results, int maxResults);
+// Closest collider hit by the ray within maxDistance. dir is normalized, a zero dir hits nothing. A ray
+// starting inside a collider hits it at distance 0.
+bool Collisions_Raycast(Vector2 origin, Vector2 dir, float maxDistance, unsigned int layerMask, RaycastHit* hit);
+// Up to k colliders whose centers are closest to point, closest first. Returns how many were found.
+int Collisions_Nearest(Vector2 point, int k, unsigned int layerMask, CID* results);
\ No newline at end of file
@@ -1,11 +1,12 @@
 #pragma once
 #include "color.h"
 
-void DebugRenderer_Init(int maxVertCount);
+void DebugRenderer_Init(int chunkVertCount); // vertices per chunk of the draw lists, they grow past it
 void DebugRenderer_NewFrame();
-void DebugRenderer_Render();
+void DebugRenderer_Render(); // pushes the draws to the render queue, in RENDER_LAYER_DEBUG
 
 void Debug_DrawVector(Vector2 v, Vector2 pos, Color32 color32);
 void Debug_DrawRect(struct Rect rect, Color32 color32 = COL32_WHITE);
 void Debug_DrawCross(Vector2 pos, Color32 color32 = COL32_WHITE);
-void Debug_DrawCircle(Vector2 pos, float radius, Color32 color32 = COL32_WHITE);
\ No newline at end of file
+void Debug_DrawCircle(Vector2 pos, float radius, Color32 color32 = COL32_WHITE);
+void Debug_DrawFilledRect(struct Rect rect, Color32 color32); // drawn under the lines
\ No newline at end of file
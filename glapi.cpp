@@ -0,0 +1,76 @@
+#include <stdio.h>
+#include <string.h>
+#include "glapi.h"
+
+GlApi gl;
+
+#define LOAD_GL_FUNC(_NAME)	(gl._NAME = (decltype(gl._NAME))glfwGetProcAddress("gl" #_NAME))
+// Core name, or the ARB extension one on older contexts
+#define LOAD_GL_FUNC_ARB(_NAME)	(LOAD_GL_FUNC(_NAME) ? gl._NAME : (gl._NAME = (decltype(gl._NAME))glfwGetProcAddress("gl" #_NAME "ARB")))
+
+static bool HasFeature(int major, int minor, const char* extension)
+{
+	return gl.version >= major * 10 + minor || glfwExtensionSupported(extension);
+}
+
+void GlApi_Load()
+{
+	memset(&gl, 0, sizeof(gl));
+	int major = 1;
+	int minor = 0;
+	const char* version = (const char*)glGetString(GL_VERSION);
+	if (version) sscanf(version, "%d.%d", &major, &minor);
+	gl.version = major * 10 + minor;
+
+	if (gl.version >= 15 && HasFeature(3, 0, "GL_ARB_map_buffer_range"))
+	{
+		LOAD_GL_FUNC(GenBuffers);
+		LOAD_GL_FUNC(DeleteBuffers);
+		LOAD_GL_FUNC(BindBuffer);
+		LOAD_GL_FUNC(BufferData);
+		LOAD_GL_FUNC(MapBufferRange);
+		LOAD_GL_FUNC(UnmapBuffer);
+		gl.buffers = gl.GenBuffers && gl.DeleteBuffers && gl.BindBuffer && gl.BufferData && gl.MapBufferRange && gl.UnmapBuffer;
+	}
+	if (HasFeature(3, 2, "GL_ARB_sync"))
+	{
+		LOAD_GL_FUNC(FenceSync);
+		LOAD_GL_FUNC(ClientWaitSync);
+		LOAD_GL_FUNC(DeleteSync);
+		gl.sync = gl.FenceSync && gl.ClientWaitSync && gl.DeleteSync;
+	}
+	if (gl.buffers && HasFeature(4, 4, "GL_ARB_buffer_storage"))
+	{
+		LOAD_GL_FUNC(BufferStorage);
+		gl.bufferStorage = gl.BufferStorage != NULL;
+	}
+	if (gl.version >= 21)
+	{
+		LOAD_GL_FUNC(CreateShader);
+		LOAD_GL_FUNC(DeleteShader);
+		LOAD_GL_FUNC(ShaderSource);
+		LOAD_GL_FUNC(CompileShader);
+		LOAD_GL_FUNC(GetShaderiv);
+		LOAD_GL_FUNC(GetShaderInfoLog);
+		LOAD_GL_FUNC(CreateProgram);
+		LOAD_GL_FUNC(AttachShader);
+		LOAD_GL_FUNC(BindAttribLocation);
+		LOAD_GL_FUNC(LinkProgram);
+		LOAD_GL_FUNC(GetProgramiv);
+		LOAD_GL_FUNC(GetProgramInfoLog);
+		LOAD_GL_FUNC(UseProgram);
+		LOAD_GL_FUNC(EnableVertexAttribArray);
+		LOAD_GL_FUNC(DisableVertexAttribArray);
+		LOAD_GL_FUNC(VertexAttribPointer);
+		gl.shaders = gl.CreateShader && gl.DeleteShader && gl.ShaderSource && gl.CompileShader && gl.GetShaderiv &&
+			gl.GetShaderInfoLog && gl.CreateProgram && gl.AttachShader && gl.BindAttribLocation && gl.LinkProgram &&
+			gl.GetProgramiv && gl.GetProgramInfoLog && gl.UseProgram && gl.EnableVertexAttribArray &&
+			gl.DisableVertexAttribArray && gl.VertexAttribPointer;
+	}
+	if (gl.shaders && HasFeature(3, 3, "GL_ARB_instanced_arrays") && HasFeature(3, 1, "GL_ARB_draw_instanced"))
+	{
+		LOAD_GL_FUNC_ARB(VertexAttribDivisor);
+		LOAD_GL_FUNC_ARB(DrawArraysInstanced);
+		gl.instancing = gl.VertexAttribDivisor && gl.DrawArraysInstanced;
+	}
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include <stddef.h>
+#include <GLFW/glfw3.h>
+
+// OpenGL past 1.1. Windows only exports 1.1 from opengl32.lib, everything newer is loaded through
+// glfwGetProcAddress by GlApi_Load once a context is current. The entry points of a missing feature
+// stay NULL and its flag false.
+
+#if defined(_WIN32)
+#define GLAPI_CALL __stdcall
+#else
+#define GLAPI_CALL
+#endif
+
+// Whatever the platform GL headers don't have
+#ifndef GL_VERSION_1_5
+typedef ptrdiff_t GLsizeiptr;
+typedef ptrdiff_t GLintptr;
+#define GL_ARRAY_BUFFER					0x8892
+#define GL_ELEMENT_ARRAY_BUFFER			0x8893
+#define GL_STREAM_DRAW					0x88E0
+#define GL_STATIC_DRAW					0x88E4
+#endif
+#ifndef GL_VERSION_2_0
+typedef char GLchar;
+#define GL_FRAGMENT_SHADER				0x8B30
+#define GL_VERTEX_SHADER				0x8B31
+#define GL_COMPILE_STATUS				0x8B81
+#define GL_LINK_STATUS					0x8B82
+#define GL_INFO_LOG_LENGTH				0x8B84
+#endif
+#ifndef GL_VERSION_3_0
+#define GL_MAP_WRITE_BIT				0x0002
+#define GL_MAP_UNSYNCHRONIZED_BIT		0x0020
+#endif
+#ifndef GL_VERSION_3_2
+typedef struct __GLsync* GLsync;
+typedef unsigned long long GLuint64;
+#define GL_SYNC_GPU_COMMANDS_COMPLETE	0x9117
+#define GL_SYNC_FLUSH_COMMANDS_BIT		0x00000001
+#define GL_ALREADY_SIGNALED				0x911A
+#define GL_CONDITION_SATISFIED			0x911C
+#define GL_WAIT_FAILED					0x911D
+#endif
+#ifndef GL_VERSION_4_4
+#define GL_MAP_PERSISTENT_BIT			0x0040
+#define GL_MAP_COHERENT_BIT				0x0080
+#endif
+
+struct GlApi
+{
+	int version;		// major * 10 + minor
+	bool buffers;		// buffer objects (1.5) that can be mapped (3.0 / ARB_map_buffer_range)
+	bool sync;			// fences (3.2 / ARB_sync)
+	bool bufferStorage;	// persistent mapping (4.4 / ARB_buffer_storage)
+	bool shaders;		// GLSL 1.20 programs (2.1)
+	bool instancing;	// instanced draws with per instance attributes (3.3 / ARB_draw_instanced + ARB_instanced_arrays)
+
+	void (GLAPI_CALL *GenBuffers)(GLsizei n, GLuint* buffers);
+	void (GLAPI_CALL *DeleteBuffers)(GLsizei n, const GLuint* buffers);
+	void (GLAPI_CALL *BindBuffer)(GLenum target, GLuint buffer);
+	void (GLAPI_CALL *BufferData)(GLenum target, GLsizeiptr size, const void* data, GLenum usage);
+	void* (GLAPI_CALL *MapBufferRange)(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access);
+	GLboolean (GLAPI_CALL *UnmapBuffer)(GLenum target);
+	void (GLAPI_CALL *BufferStorage)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+	GLsync (GLAPI_CALL *FenceSync)(GLenum condition, GLbitfield flags);
+	GLenum (GLAPI_CALL *ClientWaitSync)(GLsync sync, GLbitfield flags, GLuint64 timeout);
+	void (GLAPI_CALL *DeleteSync)(GLsync sync);
+
+	GLuint (GLAPI_CALL *CreateShader)(GLenum type);
+	void (GLAPI_CALL *DeleteShader)(GLuint shader);
+	void (GLAPI_CALL *ShaderSource)(GLuint shader, GLsizei count, const GLchar* const* string, const GLint* length);
+	void (GLAPI_CALL *CompileShader)(GLuint shader);
+	void (GLAPI_CALL *GetShaderiv)(GLuint shader, GLenum pname, GLint* params);
+	void (GLAPI_CALL *GetShaderInfoLog)(GLuint shader, GLsizei bufSize, GLsizei* length, GLchar* infoLog);
+	GLuint (GLAPI_CALL *CreateProgram)();
+	void (GLAPI_CALL *AttachShader)(GLuint program, GLuint shader);
+	void (GLAPI_CALL *BindAttribLocation)(GLuint program, GLuint index, const GLchar* name);
+	void (GLAPI_CALL *LinkProgram)(GLuint program);
+	void (GLAPI_CALL *GetProgramiv)(GLuint program, GLenum pname, GLint* params);
+	void (GLAPI_CALL *GetProgramInfoLog)(GLuint program, GLsizei bufSize, GLsizei* length, GLchar* infoLog);
+	void (GLAPI_CALL *UseProgram)(GLuint program);
+	void (GLAPI_CALL *EnableVertexAttribArray)(GLuint index);
+	void (GLAPI_CALL *DisableVertexAttribArray)(GLuint index);
+	void (GLAPI_CALL *VertexAttribPointer)(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* pointer);
+	void (GLAPI_CALL *VertexAttribDivisor)(GLuint index, GLuint divisor);
+	void (GLAPI_CALL *DrawArraysInstanced)(GLenum mode, GLint first, GLsizei count, GLsizei instancecount);
+};
+
+extern GlApi gl;
+
+void GlApi_Load();
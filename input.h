@@ -21,6 +21,8 @@ enum ButtonVal
 	BUTTON_LSHIFT,
 	BUTTON_ENTER,
 	BUTTON_ESC,
+	BUTTON_F1,
+	BUTTON_F2,
 	MAX_BUTTONS,
 };
 
@@ -0,0 +1,126 @@
+#include <assert.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include "jobs.h"
+
+#define JOBS_MAX_WORKERS	63
+
+struct JobsPool
+{
+	std::thread workers[JOBS_MAX_WORKERS];
+	int workerCount;
+
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	unsigned int jobGeneration;	// bumped for every job, workers wake up when it changes
+	int busyWorkers;
+	bool quit;
+
+	// Current job
+	JobsRangeFunc func;
+	void* context;
+	int count;
+	int batchSize;
+	int batchCount;
+	std::atomic<int> nextBatch;
+};
+static JobsPool pool;
+
+static void RunBatches(int threadIndex)
+{
+	for (;;)
+	{
+		int batch = pool.nextBatch.fetch_add(1);
+		if (batch >= pool.batchCount) break;
+		int begin = batch * pool.batchSize;
+		int end = begin + pool.batchSize < pool.count ? begin + pool.batchSize : pool.count;
+		pool.func(pool.context, begin, end, threadIndex);
+	}
+}
+
+static void WorkerLoop(int threadIndex)
+{
+	unsigned int seenGeneration = 0;
+	std::unique_lock<std::mutex> lock(pool.mutex);
+	for (;;)
+	{
+		pool.wake.wait(lock, [&] { return pool.quit || pool.jobGeneration != seenGeneration; });
+		if (pool.quit) return;
+		seenGeneration = pool.jobGeneration;
+
+		lock.unlock();
+		RunBatches(threadIndex);
+		lock.lock();
+
+		if (--pool.busyWorkers == 0) pool.done.notify_one();
+	}
+}
+
+void Jobs_Init(int workerCount)
+{
+	assert(pool.workerCount == 0);
+	if (workerCount < 0) workerCount = (int)std::thread::hardware_concurrency() - 1;
+	if (workerCount < 0) workerCount = 0;
+	if (workerCount > JOBS_MAX_WORKERS) workerCount = JOBS_MAX_WORKERS;
+
+	pool.quit = false;
+	pool.jobGeneration = 0;
+	pool.busyWorkers = 0;
+	for (int i = 0; i < workerCount; i++)
+	{
+		pool.workers[i] = std::thread(WorkerLoop, i + 1);
+	}
+	pool.workerCount = workerCount;
+}
+
+void Jobs_Shutdown()
+{
+	{
+		std::lock_guard<std::mutex> lock(pool.mutex);
+		pool.quit = true;
+	}
+	pool.wake.notify_all();
+	for (int i = 0; i < pool.workerCount; i++)
+	{
+		pool.workers[i].join();
+	}
+	pool.workerCount = 0;
+}
+
+int Jobs_GetThreadCount()
+{
+	return pool.workerCount + 1;
+}
+
+void Jobs_ParallelFor(int count, int batchSize, JobsRangeFunc func, void* context)
+{
+	assert(batchSize > 0);
+	if (count <= 0) return;
+	if (pool.workerCount == 0 || count <= batchSize)
+	{
+		func(context, 0, count, 0);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(pool.mutex);
+		assert(pool.busyWorkers == 0); // no nesting
+		pool.func = func;
+		pool.context = context;
+		pool.count = count;
+		pool.batchSize = batchSize;
+		pool.batchCount = (count + batchSize - 1) / batchSize;
+		pool.nextBatch.store(0);
+		pool.busyWorkers = pool.workerCount;
+		pool.jobGeneration++;
+	}
+	pool.wake.notify_all();
+
+	RunBatches(0);
+
+	std::unique_lock<std::mutex> lock(pool.mutex);
+	pool.done.wait(lock, [] { return pool.busyWorkers == 0; });
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+// Small worker pool for data parallel loops. Jobs_ParallelFor splits [0, count) into batches that the
+// workers and the calling thread take in turn, and returns once every batch ran.
+// It must only be called from the main thread and doesn't nest. Before Jobs_Init (or with no workers)
+// everything runs on the calling thread.
+
+// threadIndex is 0 on the calling thread, [1, Jobs_GetThreadCount()) on the workers
+typedef void (*JobsRangeFunc)(void* context, int begin, int end, int threadIndex);
+
+void Jobs_Init(int workerCount); // < 0 picks one worker per hardware thread besides the main one
+void Jobs_Shutdown();
+int Jobs_GetThreadCount(); // workers + the calling thread
+void Jobs_ParallelFor(int count, int batchSize, JobsRangeFunc func, void* context);
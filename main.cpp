@@ -11,11 +11,14 @@
 #include "utils.h"
 #include "debugrender.h"
 #include "text.h"
+#include "glapi.h"
+#include "jobs.h"
+#include "renderqueue.h"
 
 // TODO:
 // [x] Text
 // [x] Menus
-// [ ] Drawing layers
+// [x] Drawing layers
 // [ ] Collision Box-Circle
 // [ ] Ship Damage/Health
 // [ ] Better time step calculation
@@ -91,10 +94,14 @@ int main(void)
 	GameInput_BindButton(BUTTON_LSHIFT, GLFW_KEY_LEFT_SHIFT);
 	GameInput_BindButton(BUTTON_ENTER, GLFW_KEY_ENTER);
 	GameInput_BindButton(BUTTON_ESC, GLFW_KEY_ESCAPE);
+	GameInput_BindButton(BUTTON_F1, GLFW_KEY_F1);
+	GameInput_BindButton(BUTTON_F2, GLFW_KEY_F2);
 	ButtonState buttonStates[MAX_BUTTONS];
 	
+	GlApi_Load();
 	Renderer_Init(2048+1024);
 	DebugRenderer_Init(1024);
+	Jobs_Init(-1);
 	glEnableClientState(GL_VERTEX_ARRAY);
 	glEnableClientState(GL_COLOR_ARRAY);
 
@@ -118,6 +125,7 @@ int main(void)
 	  DebugRenderer_NewFrame();
 
 	  GameUpdate();
+	  RenderQueue_Submit();
 
 	  glfwMakeContextCurrent(window);
 	  glfwSwapBuffers(window);
@@ -125,6 +133,7 @@ int main(void)
 	  if (game.doQuit) break;
 	}
 
+	Jobs_Shutdown();
 	glfwDestroyWindow(window);
 	glfwTerminate();
 	return 0;
@@ -0,0 +1,75 @@
+#include <string.h>
+#include "narrowphase.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define NARROWPHASE_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define NARROWPHASE_SSE2
+#endif
+
+static void ClearMask(unsigned int* hitMask, int count)
+{
+	memset(hitMask, 0, sizeof(unsigned int) * ((count + 31) / 32));
+}
+
+void Narrowphase_CircleCircleScalar(const float* x1, const float* y1, const float* x2, const float* y2, const float* radiusSum, int count, unsigned int* hitMask)
+{
+	ClearMask(hitMask, count);
+	for (int i = 0; i < count; i++)
+	{
+		float dx = x2[i] - x1[i];
+		float dy = y2[i] - y1[i];
+		float r = radiusSum[i];
+		if (dx * dx + dy * dy < r * r) hitMask[i / 32] |= 1U << (i % 32);
+	}
+}
+
+void Narrowphase_CircleCircle(const float* x1, const float* y1, const float* x2, const float* y2, const float* radiusSum, int count, unsigned int* hitMask)
+{
+	int i = 0;
+	ClearMask(hitMask, count);
+
+#if defined(NARROWPHASE_AVX2)
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 dx = _mm256_sub_ps(_mm256_loadu_ps(x2 + i), _mm256_loadu_ps(x1 + i));
+		__m256 dy = _mm256_sub_ps(_mm256_loadu_ps(y2 + i), _mm256_loadu_ps(y1 + i));
+		__m256 r = _mm256_loadu_ps(radiusSum + i);
+		__m256 distSq = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+		unsigned int bits = (unsigned int)_mm256_movemask_ps(_mm256_cmp_ps(distSq, _mm256_mul_ps(r, r), _CMP_LT_OQ));
+		hitMask[i / 32] |= bits << (i % 32);
+	}
+#elif defined(NARROWPHASE_SSE2)
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 dx = _mm_sub_ps(_mm_loadu_ps(x2 + i), _mm_loadu_ps(x1 + i));
+		__m128 dy = _mm_sub_ps(_mm_loadu_ps(y2 + i), _mm_loadu_ps(y1 + i));
+		__m128 r = _mm_loadu_ps(radiusSum + i);
+		__m128 distSq = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+		unsigned int bits = (unsigned int)_mm_movemask_ps(_mm_cmplt_ps(distSq, _mm_mul_ps(r, r)));
+		hitMask[i / 32] |= bits << (i % 32);
+	}
+#endif
+
+	// Tail
+	for (; i < count; i++)
+	{
+		float dx = x2[i] - x1[i];
+		float dy = y2[i] - y1[i];
+		float r = radiusSum[i];
+		if (dx * dx + dy * dy < r * r) hitMask[i / 32] |= 1U << (i % 32);
+	}
+}
+
+const char* Narrowphase_GetPath()
+{
+#if defined(NARROWPHASE_AVX2)
+	return "avx2";
+#elif defined(NARROWPHASE_SSE2)
+	return "sse2";
+#else
+	return "scalar";
+#endif
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+// Batched circle-circle tests. Candidate pairs are packed in SoA lanes and compared by squared
+// distance against the squared radius sum, so there is no sqrt and no pointer chasing.
+// Bit i of hitMask is set if pair i overlaps; hitMask must hold (count + 31) / 32 words.
+
+#define NARROWPHASE_BATCH_SIZE	256
+
+struct CirclePairBatch
+{
+	float x1[NARROWPHASE_BATCH_SIZE];
+	float y1[NARROWPHASE_BATCH_SIZE];
+	float x2[NARROWPHASE_BATCH_SIZE];
+	float y2[NARROWPHASE_BATCH_SIZE];
+	float radiusSum[NARROWPHASE_BATCH_SIZE];
+	int count;
+};
+
+void Narrowphase_CircleCircle(const float* x1, const float* y1, const float* x2, const float* y2, const float* radiusSum, int count, unsigned int* hitMask);
+void Narrowphase_CircleCircleScalar(const float* x1, const float* y1, const float* x2, const float* y2, const float* radiusSum, int count, unsigned int* hitMask);
+const char* Narrowphase_GetPath(); // "avx2", "sse2" or "scalar"
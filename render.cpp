@@ -1,61 +1,1020 @@
 #include <stdint.h>
 #include <string.h>
+#include <stdio.h>
+#include <math.h>
 #include <GLFW/glfw3.h>
 #include <stdlib.h>
 #include <assert.h>
 #include "render.h"
+#include "streambuffer.h"
+#include "renderqueue.h"
 #include "utils.h"
 
-static DrawList drawList;
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define RENDER_AVX2
+#endif
+
+static_assert(DRAW_MODE_LINES == GL_LINES && DRAW_MODE_TRIANGLES == GL_TRIANGLES, "DrawList_Draw passes the mode to GL");
+
+// Attribute slots clear of the ones NVIDIA aliases to the fixed function arrays (0 vertex, 2 normal, 3 color)
+#define ATTRIB_EDGES	5
+#define ATTRIB_INSTANCE	6
+#define ATTRIB_COLOR	7
+
+struct PolygonInstance
+{
+	Vector2 pos;
+	float radius;
+	float angle;	// radians
+	float edgeCount;
+	Color32 color32;
+};
+
+// One chunk of a DrawList: DrawChunk.stream holds chunkVertCount vertices and indices
+struct DrawChunk
+{
+	StreamBuffer stream;
+	int vertCount;	// filled this frame
+	int idxCount;
+	bool indexed;
+};
+
+// Position in a DrawList between two shapes
+struct DrawListMark
+{
+	int chunk;
+	int vertCount;
+	int idxCount;
+};
+
+// N-gons pushed one after the other with no tessellated shape in between, drawn with one instanced call
+// after the tessellated shapes pushed before them
+struct InstanceRun
+{
+	DrawListMark mark;	// of the draw list when the run started
+	int first;			// record of the list, of instanceStream once streamed
+	int count;
+	int maxEdges;		// the fan drawn for every record, the smaller n-gons close early on degenerate triangles
+};
+
+// Where shapes are pushed: the list of a layer streamed to GL, or a recording list filled on another thread
+struct RecordList
+{
+	RenderLayer layer;			// of a recording list, the layer list it is merged into
+	DrawList drawList;
+	PolygonInstance* instances;	// in submission order, streamed layer by layer into instanceStream at Render
+	int instanceCount;
+	int maxInstanceCount;		// grows when a frame has more
+	InstanceRun* runs;			// of a layer list, the runs of its recording lists are added at Render
+	int runCount;
+	int maxRunCount;
+	int* batchOrder;			// shape indices of a DrawCircles batch sorted by edge count
+	int batchOrderCapacity;
+};
+
+static RecordList layerLists[RENDER_LAYER_COUNT];	// streamed to GL, drawn in layer order by the render queue
+static RenderLayer layer;		// of the shapes of the main thread
+static RecordList* lists;		// recording lists, merged after the layer lists at Render
+static int listCount;			// added this frame
+static int listCapacity;		// initialized
+static thread_local RecordList* recordList;	// of the calling thread, between Renderer_BeginList and EndList
 static unsigned long frameCounter;
+static RendererStats stats;
+static DrawChunkFunc drawFunc;	// NULL for GL
+
+// Unit n-gon rims, counterclockwise from angle 0
+static Vector2 unitRims[(RENDERER_MAX_POLYGON_EDGES + 3) * (RENDERER_MAX_POLYGON_EDGES - 2) / 2];
+static int unitRimFirst[RENDERER_MAX_POLYGON_EDGES + 1];
+#if defined(RENDER_AVX2)
+// Fan indices of the unit rims relative to the center, at 3 * unitRimFirst, padded for 16 wide reads
+static DrawIdx unitFans[3 * ARRAY_COUNT(unitRims) + 16];
+#endif
+
+static bool instancing;
+static GLuint polygonProgram;
+static GLuint meshVbo;			// the fan of every edge count, see CreatePolygonMesh
+static StreamBuffer instanceStream;
+static int maxInstanceCount;	// instanceStream records, grows when a frame has more
+
+// The fan vertex is placed on the rim of the n-gon of the instance, the fixed function arrays feed gl_Vertex:
+// x the rim vertex, y 0 for the center and 1 for the rim. Past the last rim vertex the fan closes on the first
+static const char* polygonVertexShader =
+	"#version 120\n"
+	"attribute vec4 instance; // pos.xy, radius, angle\n"
+	"attribute float edgeCount;\n"
+	"attribute vec4 color;\n"
+	"void main()\n"
+	"{\n"
+	"	float rim = gl_Vertex.x < edgeCount ? gl_Vertex.x : 0.0;\n"
+	"	float angle = instance.w + 6.28318531 * rim / edgeCount;\n"
+	"	vec2 v = instance.z * gl_Vertex.y * vec2(cos(angle), sin(angle));\n"
+	"	gl_Position = gl_ModelViewProjectionMatrix * vec4(instance.xy + v, 0.0, 1.0);\n"
+	"	gl_FrontColor = color;\n"
+	"}\n";
+
+static const char* polygonFragmentShader =
+	"#version 120\n"
+	"void main()\n"
+	"{\n"
+	"	gl_FragColor = gl_Color;\n"
+	"}\n";
 
-void Renderer_Init(int maxVertCount)
+static GLuint CompileShader(GLenum type, const char* source)
 {
-	assert(maxVertCount < UINT16_MAX);
-	memset(&drawList, 0, sizeof(drawList));
+	GLuint shader = gl.CreateShader(type);
+	gl.ShaderSource(shader, 1, &source, NULL);
+	gl.CompileShader(shader);
+	GLint status = 0;
+	gl.GetShaderiv(shader, GL_COMPILE_STATUS, &status);
+	if (!status)
+	{
+		char log[1024];
+		gl.GetShaderInfoLog(shader, sizeof(log), NULL, log);
+		fprintf(stderr, "Renderer: polygon shader failed to compile:\n%s\n", log);
+		gl.DeleteShader(shader);
+		return 0;
+	}
+	return shader;
+}
+
+static GLuint CreatePolygonProgram()
+{
+	GLuint vs = CompileShader(GL_VERTEX_SHADER, polygonVertexShader);
+	GLuint fs = CompileShader(GL_FRAGMENT_SHADER, polygonFragmentShader);
+	if (!vs || !fs)
+	{
+		if (vs) gl.DeleteShader(vs);
+		if (fs) gl.DeleteShader(fs);
+		return 0;
+	}
+
+	GLuint program = gl.CreateProgram();
+	gl.AttachShader(program, vs);
+	gl.AttachShader(program, fs);
+	gl.BindAttribLocation(program, ATTRIB_INSTANCE, "instance");
+	gl.BindAttribLocation(program, ATTRIB_EDGES, "edgeCount");
+	gl.BindAttribLocation(program, ATTRIB_COLOR, "color");
+	gl.LinkProgram(program);
+	gl.DeleteShader(vs);
+	gl.DeleteShader(fs);
+	GLint status = 0;
+	gl.GetProgramiv(program, GL_LINK_STATUS, &status);
+	if (!status)
+	{
+		char log[1024];
+		gl.GetProgramInfoLog(program, sizeof(log), NULL, log);
+		fprintf(stderr, "Renderer: polygon shader failed to link:\n%s\n", log);
+		return 0;
+	}
+	return program;
+}
 
-	drawList.vertBuffer = (DrawVert*)malloc(sizeof(DrawVert) * maxVertCount);
-	drawList.idxBuffer = (DrawIdx*)malloc(sizeof(DrawIdx) * maxVertCount);
-	drawList.maxVertCount = maxVertCount;
+static inline void WriteFanIndices(DrawIdx* idx, DrawIdx centerIdx, int edgeCount)
+{
+	for (int i = 0; i < edgeCount; i++)
+	{
+		idx[i * 3 + 0] = centerIdx;
+		idx[i * 3 + 1] = (DrawIdx)(centerIdx + i + 1);
+		idx[i * 3 + 2] = (DrawIdx)(centerIdx + i + 2);
+	}
+	idx[edgeCount * 3 - 1] = centerIdx + 1; // the last triangle closes on the first rim vertex
+}
+
+static void CreateUnitRims()
+{
+	int vertCount = 0;
+	for (int e = 3; e <= RENDERER_MAX_POLYGON_EDGES; e++)
+	{
+		unitRimFirst[e] = vertCount;
+		for (int i = 0; i < e; i++)
+		{
+			float angle = 2.0f * PI * i / e;
+			unitRims[vertCount + i] = V2(cosf(angle), sinf(angle));
+		}
+#if defined(RENDER_AVX2)
+		WriteFanIndices(&unitFans[3 * vertCount], 0, e);
+#endif
+		vertCount += e;
+	}
+	assert(vertCount == (int)ARRAY_COUNT(unitRims));
+}
+
+// A fan of the center then rim vertices 0 to RENDERER_MAX_POLYGON_EDGES, the shader closes it on vertex 0
+// once past the edge count of the instance. The first edgeCount + 2 vertices of an n-gon make the same
+// triangles DrawCircleWStartAngle tessellates
+static void CreatePolygonMesh()
+{
+	Vector2 fan[RENDERER_MAX_POLYGON_EDGES + 2];
+	fan[0] = V2(-1.0f, 0.0f);
+	for (int i = 0; i <= RENDERER_MAX_POLYGON_EDGES; i++)
+	{
+		fan[1 + i] = V2((float)i, 1.0f);
+	}
+	gl.GenBuffers(1, &meshVbo);
+	gl.BindBuffer(GL_ARRAY_BUFFER, meshVbo);
+	gl.BufferData(GL_ARRAY_BUFFER, sizeof(fan), fan, GL_STATIC_DRAW);
+	gl.BindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+static void MapChunk(DrawList* drawList, int chunk)
+{
+	if (chunk == drawList->chunkCount)
+	{
+		drawList->chunkCount++;
+		drawList->chunks = (DrawChunk*)realloc(drawList->chunks, sizeof(DrawChunk) * drawList->chunkCount);
+		int idxBytes = sizeof(DrawIdx) * drawList->chunkVertCount * DRAW_CHUNK_IDX_PER_VERT;
+		StreamBuffer_InitBytes(&drawList->chunks[chunk].stream, sizeof(DrawVert) * drawList->chunkVertCount, idxBytes, drawList->clientArrays);
+	}
+	StreamBuffer* stream = &drawList->chunks[chunk].stream;
+	StreamBuffer_Map(stream);
+	drawList->chunk = chunk;
+	drawList->vertBuffer = (DrawVert*)stream->writeVerts;
+	drawList->idxBuffer = (DrawIdx*)stream->writeIdxs;
+	drawList->vertCount = 0;
+	drawList->maxVertCount = drawList->chunkVertCount;
+	drawList->idxCount = 0;
+	drawList->maxIdxCount = drawList->chunkVertCount * DRAW_CHUNK_IDX_PER_VERT;
+	drawList->indexed = false;
+}
+
+static void EndChunk(DrawList* drawList)
+{
+	DrawChunk* chunk = &drawList->chunks[drawList->chunk];
+	chunk->vertCount = drawList->vertCount;
+	chunk->idxCount = drawList->idxCount;
+	chunk->indexed = drawList->indexed;
+}
+
+void DrawList_Init(DrawList* drawList, int chunkVertCount, bool clientArrays)
+{
+	assert(chunkVertCount > 0 && chunkVertCount <= DRAW_CHUNK_MAX_VERTS);
+	memset(drawList, 0, sizeof(*drawList));
+	drawList->chunkVertCount = chunkVertCount;
+	drawList->clientArrays = clientArrays;
+	MapChunk(drawList, 0);
+}
+
+void DrawList_Begin(DrawList* drawList)
+{
+	MapChunk(drawList, 0);
+}
+
+void DrawList_NextChunk(DrawList* drawList)
+{
+	EndChunk(drawList);
+	MapChunk(drawList, drawList->chunk + 1);
+}
+
+void DrawList_IndexChunk(DrawList* drawList)
+{
+	// Only sequential primitives so far, idxCount == vertCount
+	for (int i = 0; i < drawList->idxCount; i++)
+	{
+		drawList->idxBuffer[i] = (DrawIdx)i;
+	}
+	drawList->indexed = true;
+}
+
+void DrawList_SetDrawFunc(DrawChunkFunc func)
+{
+	drawFunc = func;
+}
+
+DrawChunkFunc DrawList_GetDrawFunc()
+{
+	return drawFunc;
+}
+
+static inline DrawListMark GetMark(const DrawList* drawList)
+{
+	DrawListMark mark = { drawList->chunk, drawList->vertCount, drawList->idxCount };
+	return mark;
+}
+
+static inline bool SameMark(DrawListMark a, DrawListMark b)
+{
+	return a.chunk == b.chunk && a.vertCount == b.vertCount;
+}
+
+// Draws the shapes pushed between two marks, one draw call per chunk they span. Returns the draw calls
+static int DrawListRange(DrawList* drawList, unsigned int mode, DrawListMark from, DrawListMark to)
+{
+	EndChunk(drawList);
+	int drawCalls = 0;
+	for (int c = from.chunk; c <= to.chunk; c++)
+	{
+		DrawChunk* chunk = &drawList->chunks[c];
+		int firstVert = c == from.chunk ? from.vertCount : 0;
+		int endVert = c == to.chunk ? to.vertCount : chunk->vertCount;
+		int firstIdx = c == from.chunk ? from.idxCount : 0;
+		int endIdx = c == to.chunk ? to.idxCount : chunk->idxCount;
+		if (endVert == firstVert) continue;
+		StreamBuffer_Bind(&chunk->stream);
+		if (drawFunc)
+		{
+			assert(chunk->stream.path == STREAM_PATH_CLIENT_ARRAYS);
+			const DrawVert* verts = (const DrawVert*)chunk->stream.drawVerts;
+			if (chunk->indexed)	drawFunc(verts, endVert, (const DrawIdx*)chunk->stream.drawIdxs + firstIdx, endIdx - firstIdx, mode);
+			else				drawFunc(verts + firstVert, endVert - firstVert, NULL, 0, mode);
+		}
+		else
+		{
+			glVertexPointer(2, GL_FLOAT, sizeof(DrawVert), chunk->stream.drawVerts + OFFSET_OF(DrawVert, vert));
+			glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(DrawVert), chunk->stream.drawVerts + OFFSET_OF(DrawVert, color32));
+			if (chunk->indexed) glDrawElements(mode, endIdx - firstIdx, GL_UNSIGNED_SHORT, (const DrawIdx*)chunk->stream.drawIdxs + firstIdx);
+			else glDrawArrays(mode, firstVert, endVert - firstVert);
+		}
+		StreamBuffer_Unbind(&chunk->stream);
+		drawCalls++;
+	}
+	return drawCalls;
+}
+
+void DrawList_Draw(DrawList* drawList, unsigned int mode)
+{
+	DrawListMark begin = {};
+	DrawListRange(drawList, mode, begin, GetMark(drawList));
+}
+
+int DrawList_GetVertCount(const DrawList* drawList)
+{
+	int vertCount = drawList->vertCount;
+	for (int c = 0; c < drawList->chunk; c++)
+	{
+		vertCount += drawList->chunks[c].vertCount;
+	}
+	return vertCount;
+}
+
+int DrawList_GetIdxCount(const DrawList* drawList)
+{
+	int idxCount = drawList->indexed ? drawList->idxCount : 0;
+	for (int c = 0; c < drawList->chunk; c++)
+	{
+		if (drawList->chunks[c].indexed) idxCount += drawList->chunks[c].idxCount;
+	}
+	return idxCount;
+}
+
+// Copies the chunks of a client arrays list to the end of another list, the indices moved to where
+// each chunk lands. Chunks hold whole shapes, so one that doesn't fit starts a new chunk of dst.
+// The marks of the runs of src are moved along to dst
+static void AppendDrawList(DrawList* dst, DrawList* src, InstanceRun* runs, int runCount)
+{
+	assert(src->clientArrays && src->chunkVertCount <= dst->chunkVertCount);
+	EndChunk(src);
+	int r = 0;
+	for (int c = 0; c <= src->chunk; c++)
+	{
+		DrawChunk* chunk = &src->chunks[c];
+		if (chunk->vertCount == 0)
+		{
+			for (; r < runCount && runs[r].mark.chunk == c; r++) runs[r].mark = GetMark(dst);
+			continue;
+		}
+		ReservedDrawData drawData = PushVerts(dst, chunk->vertCount, chunk->indexed ? chunk->idxCount : 0);
+		int firstIdx = dst->idxCount - (chunk->indexed ? chunk->idxCount : chunk->vertCount);
+		for (; r < runCount && runs[r].mark.chunk == c; r++)
+		{
+			runs[r].mark.chunk = dst->chunk;
+			runs[r].mark.vertCount += drawData.firstIdx;
+			runs[r].mark.idxCount += firstIdx;
+		}
+		memcpy(drawData.vertBuffer, chunk->stream.writeVerts, sizeof(DrawVert) * chunk->vertCount);
+		if (!chunk->indexed) continue;
+		const DrawIdx* idxs = (const DrawIdx*)chunk->stream.writeIdxs;
+		for (int i = 0; i < chunk->idxCount; i++)
+		{
+			drawData.idxBuffer[i] = (DrawIdx)(idxs[i] + drawData.firstIdx);
+		}
+	}
+}
+
+static void InitRecordList(RecordList* list, RenderLayer layer, int chunkVertCount, bool clientArrays)
+{
+	memset(list, 0, sizeof(*list));
+	list->layer = layer;
+	DrawList_Init(&list->drawList, chunkVertCount, clientArrays);
+	if (instancing)
+	{
+		// Every instance stands in for at least 9 tessellated vertices
+		list->maxInstanceCount = chunkVertCount / 9 + 1;
+		list->instances = (PolygonInstance*)malloc(sizeof(PolygonInstance) * list->maxInstanceCount);
+		list->maxRunCount = 16;
+		list->runs = (InstanceRun*)malloc(sizeof(InstanceRun) * list->maxRunCount);
+	}
+}
+
+static inline RecordList* GetRecordList()
+{
+	return recordList ? recordList : &layerLists[layer];
+}
+
+// The fan mesh feeds gl_Vertex, the records the instance attributes
+static void BeginInstances()
+{
+	gl.UseProgram(polygonProgram);
+	glDisableClientState(GL_COLOR_ARRAY);
+	gl.EnableVertexAttribArray(ATTRIB_INSTANCE);
+	gl.EnableVertexAttribArray(ATTRIB_EDGES);
+	gl.EnableVertexAttribArray(ATTRIB_COLOR);
+	gl.VertexAttribDivisor(ATTRIB_INSTANCE, 1);
+	gl.VertexAttribDivisor(ATTRIB_EDGES, 1);
+	gl.VertexAttribDivisor(ATTRIB_COLOR, 1);
+	gl.BindBuffer(GL_ARRAY_BUFFER, meshVbo);
+	glVertexPointer(2, GL_FLOAT, sizeof(Vector2), NULL);
+	gl.BindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+static void EndInstances()
+{
+	gl.VertexAttribDivisor(ATTRIB_INSTANCE, 0);
+	gl.VertexAttribDivisor(ATTRIB_EDGES, 0);
+	gl.VertexAttribDivisor(ATTRIB_COLOR, 0);
+	gl.DisableVertexAttribArray(ATTRIB_INSTANCE);
+	gl.DisableVertexAttribArray(ATTRIB_EDGES);
+	gl.DisableVertexAttribArray(ATTRIB_COLOR);
+	glEnableClientState(GL_COLOR_ARRAY);
+	gl.UseProgram(0);
+}
+
+void Renderer_Init(int chunkVertCount, bool useInstancing)
+{
+	memset(&stats, 0, sizeof(stats));
+	CreateUnitRims();
+
+	instancing = false;
+	if (useInstancing && gl.instancing && gl.buffers)
+	{
+		polygonProgram = CreatePolygonProgram();
+		if (polygonProgram)
+		{
+			maxInstanceCount = chunkVertCount / 9 + 1;
+			StreamBuffer_InitBytes(&instanceStream, sizeof(PolygonInstance) * maxInstanceCount, 0);
+			CreatePolygonMesh();
+			instancing = true;
+		}
+	}
+	for (int l = 0; l < RENDER_LAYER_COUNT; l++)
+	{
+		InitRecordList(&layerLists[l], (RenderLayer)l, chunkVertCount, false);
+	}
 
 	frameCounter = 0;
 }
 
 void Renderer_NewFrame()
 {
-	drawList.vertCount = 0;
+	for (int l = 0; l < RENDER_LAYER_COUNT; l++)
+	{
+		DrawList_Begin(&layerLists[l].drawList);
+		layerLists[l].instanceCount = 0;
+		layerLists[l].runCount = 0;
+	}
+	layer = RENDER_LAYER_WORLD;
+	listCount = 0;
 	frameCounter++;
 }
 
+void Renderer_SetLayer(RenderLayer newLayer)
+{
+	assert(recordList == NULL);
+	layer = newLayer;
+}
+
+int Renderer_AddLists(int count)
+{
+	if (listCount + count > listCapacity)
+	{
+		lists = (RecordList*)realloc(lists, sizeof(RecordList) * (listCount + count));
+		for (int l = listCapacity; l < listCount + count; l++)
+		{
+			InitRecordList(&lists[l], layer, layerLists[0].drawList.chunkVertCount, true);
+		}
+		listCapacity = listCount + count;
+	}
+	for (int l = listCount; l < listCount + count; l++)
+	{
+		lists[l].layer = layer;
+		DrawList_Begin(&lists[l].drawList);
+		lists[l].instanceCount = 0;
+		lists[l].runCount = 0;
+	}
+	int first = listCount;
+	listCount += count;
+	return first;
+}
+
+void Renderer_BeginList(int list)
+{
+	assert(list >= 0 && list < listCount && recordList == NULL);
+	recordList = &lists[list];
+}
+
+void Renderer_EndList()
+{
+	recordList = NULL;
+}
+
+// Maps the instance stream for the records of a frame
+static PolygonInstance* MapInstances(int instanceCount)
+{
+	if (instanceCount > maxInstanceCount)
+	{
+		while (instanceCount > maxInstanceCount) maxInstanceCount *= 2;
+		StreamBuffer_Free(&instanceStream);
+		StreamBuffer_InitBytes(&instanceStream, sizeof(PolygonInstance) * maxInstanceCount, 0);
+	}
+	StreamBuffer_Map(&instanceStream);
+	return (PolygonInstance*)instanceStream.writeVerts;
+}
+
+static void ReserveRuns(RecordList* list, int count)
+{
+	if (list->runCount + count <= list->maxRunCount) return;
+	while (list->runCount + count > list->maxRunCount) list->maxRunCount *= 2;
+	list->runs = (InstanceRun*)realloc(list->runs, sizeof(InstanceRun) * list->maxRunCount);
+}
+
+// Writes the records of list into the instance stream after the streamed ones and adds its runs to the
+// layer list. A run with no tessellated shape between it and the last run of the layer list joins it.
+// Returns the records streamed
+static int StreamRuns(RecordList* layerList, RecordList* list, PolygonInstance* records, int streamed)
+{
+	memcpy(&records[streamed], list->instances, sizeof(PolygonInstance) * list->instanceCount);
+	if (list == layerList)
+	{
+		for (int r = 0; r < list->runCount; r++) list->runs[r].first += streamed;
+		return streamed + list->instanceCount;
+	}
+	ReserveRuns(layerList, list->runCount);
+	for (int r = 0; r < list->runCount; r++)
+	{
+		InstanceRun run = list->runs[r];
+		run.first += streamed;
+		InstanceRun* last = layerList->runCount > 0 ? &layerList->runs[layerList->runCount - 1] : NULL;
+		if (last && SameMark(last->mark, run.mark))
+		{
+			last->count += run.count;
+			if (run.maxEdges > last->maxEdges) last->maxEdges = run.maxEdges;
+			continue;
+		}
+		layerList->runs[layerList->runCount++] = run;
+	}
+	return streamed + list->instanceCount;
+}
+
+static void DrawInstanceRun(const InstanceRun* run)
+{
+	StreamBuffer_Bind(&instanceStream);
+	// No base instance before GL 4.2, each run points the instance attributes at its records
+	const unsigned char* records = instanceStream.drawVerts + sizeof(PolygonInstance) * run->first;
+	gl.VertexAttribPointer(ATTRIB_INSTANCE, 4, GL_FLOAT, GL_FALSE, sizeof(PolygonInstance), records + OFFSET_OF(PolygonInstance, pos));
+	gl.VertexAttribPointer(ATTRIB_EDGES, 1, GL_FLOAT, GL_FALSE, sizeof(PolygonInstance), records + OFFSET_OF(PolygonInstance, edgeCount));
+	gl.VertexAttribPointer(ATTRIB_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(PolygonInstance), records + OFFSET_OF(PolygonInstance, color32));
+	gl.DrawArraysInstanced(GL_TRIANGLE_FAN, 0, run->maxEdges + 2, run->count);
+	StreamBuffer_Unbind(&instanceStream);
+}
+
+// context: the layer list. Its tessellated shapes are drawn in pieces between the instance runs, so
+// that every shape covers the ones pushed before it
+static void DrawLayer(void* context)
+{
+	RecordList* list = (RecordList*)context;
+	assert(list->runCount == 0 || !drawFunc); // the draw func was set while the frame was recorded
+	DrawListMark from = {};
+	for (int r = 0; r < list->runCount; r++)
+	{
+		const InstanceRun* run = &list->runs[r];
+		stats.drawCalls += DrawListRange(&list->drawList, DRAW_MODE_TRIANGLES, from, run->mark);
+		BeginInstances();
+		DrawInstanceRun(run);
+		EndInstances();
+		stats.drawCalls++;
+		from = run->mark;
+	}
+	stats.drawCalls += DrawListRange(&list->drawList, DRAW_MODE_TRIANGLES, from, GetMark(&list->drawList));
+}
+
 void Renderer_Render()
 {
-	glVertexPointer(2, GL_FLOAT, sizeof(DrawVert), (uint8_t*)drawList.vertBuffer + OFFSET_OF(DrawVert, vert));
-	glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(DrawVert), (uint8_t*)drawList.vertBuffer + OFFSET_OF(DrawVert, color32));
-	glDrawElements(GL_TRIANGLES, drawList.vertCount, GL_UNSIGNED_SHORT, drawList.idxBuffer);
+	assert(recordList == NULL);
+	memset(&stats, 0, sizeof(stats));
+	int instanceCount = 0;
+	for (int l = 0; l < RENDER_LAYER_COUNT; l++)
+	{
+		instanceCount += layerLists[l].instanceCount;
+	}
+	for (int l = 0; l < listCount; l++)
+	{
+		instanceCount += lists[l].instanceCount;
+	}
+	PolygonInstance* records = instanceCount > 0 ? MapInstances(instanceCount) : NULL;
+
+	int streamed = 0;
+	for (int l = 0; l < RENDER_LAYER_COUNT; l++)
+	{
+		RecordList* layerList = &layerLists[l];
+		if (records) streamed = StreamRuns(layerList, layerList, records, streamed);
+		for (int i = 0; i < listCount; i++)
+		{
+			if (lists[i].layer != l) continue;
+			AppendDrawList(&layerList->drawList, &lists[i].drawList, lists[i].runs, lists[i].runCount);
+			if (records) streamed = StreamRuns(layerList, &lists[i], records, streamed);
+		}
+
+		int vertCount = DrawList_GetVertCount(&layerList->drawList);
+		if (vertCount == 0 && layerList->runCount == 0) continue;
+		RenderQueue_Push(RENDER_KEY(l, RENDER_PRIMITIVE_TRIANGLES, 0, 0), DrawLayer, layerList);
+		stats.vertices += vertCount;
+		stats.uploadBytes += sizeof(DrawVert) * vertCount + sizeof(DrawIdx) * DrawList_GetIdxCount(&layerList->drawList);
+	}
+	stats.instances = instanceCount;
+	stats.uploadBytes += sizeof(PolygonInstance) * instanceCount;
+}
+
+const char* Renderer_GetStreamPath()
+{
+	return StreamBuffer_GetPathName(layerLists[0].drawList.chunks[0].stream.path);
+}
+
+bool Renderer_IsInstancing()
+{
+	return instancing && !drawFunc;
+}
+
+const RendererStats* Renderer_GetStats()
+{
+	return &stats;
+}
+
+// Joins the last run unless tessellated shapes were pushed since
+static inline void PushInstance(RecordList* list, Vector2 pos, float radius, Color32 color32, int edgeCount, float startAngle)
+{
+	DrawListMark mark = GetMark(&list->drawList);
+	InstanceRun* run = list->runCount > 0 ? &list->runs[list->runCount - 1] : NULL;
+	if (!run || !SameMark(run->mark, mark))
+	{
+		ReserveRuns(list, 1);
+		run = &list->runs[list->runCount++];
+		run->mark = mark;
+		run->first = list->instanceCount;
+		run->count = 0;
+		run->maxEdges = 0;
+	}
+	run->count++;
+	if (edgeCount > run->maxEdges) run->maxEdges = edgeCount;
+
+	PolygonInstance* instance = &list->instances[list->instanceCount];
+	instance->pos = pos;
+	instance->radius = radius;
+	instance->angle = DegToRad(startAngle);
+	instance->edgeCount = (float)edgeCount;
+	instance->color32 = color32;
+	list->instanceCount++;
+}
+
+static void ReserveInstances(RecordList* list, int count)
+{
+	if (list->instanceCount + count <= list->maxInstanceCount) return;
+	while (list->instanceCount + count > list->maxInstanceCount) list->maxInstanceCount *= 2;
+	list->instances = (PolygonInstance*)realloc(list->instances, sizeof(PolygonInstance) * list->maxInstanceCount);
+}
+
+static void TessellatePolygon(DrawList* drawList, Vector2 pos, float radius, Color32 color32, int edgeCount, float startAngle)
+{
+	if (edgeCount < 3) return; // no area, and the fan needs a triangle to close
+
+	// Center then the rim, the triangles fan out from the center
+	ReservedDrawData drawData = PushVerts(drawList, edgeCount + 1, edgeCount * 3);
+
+	drawData.vertBuffer[0].vert = pos; drawData.vertBuffer[0].color32 = color32;
+	if (edgeCount <= RENDERER_MAX_POLYGON_EDGES)
+	{
+		// Scale, rotate and move the cached unit rim, one sincos for the shape
+		float angle = DegToRad(startAngle);
+		float c = radius * cosf(angle);
+		float s = radius * sinf(angle);
+		const Vector2* rim = &unitRims[unitRimFirst[edgeCount]];
+		for (int i = 0; i < edgeCount; i++)
+		{
+			Vector2 u = rim[i];
+			drawData.vertBuffer[i + 1].vert = pos + V2(c * u.x - s * u.y, s * u.x + c * u.y); drawData.vertBuffer[i + 1].color32 = color32;
+		}
+	}
+	else
+	{
+		float theta = 360.0f / edgeCount;
+		Vector2 v = radius * Rotate(VECTOR2_RIGHT, startAngle);
+		for (int i = 0; i < edgeCount; i++)
+		{
+			drawData.vertBuffer[i + 1].vert = pos + v; drawData.vertBuffer[i + 1].color32 = color32;
+			v = Rotate(v, theta);
+		}
+	}
+
+	WriteFanIndices(drawData.idxBuffer, drawData.firstIdx, edgeCount);
 }
 
 void DrawCircleWStartAngle(Vector2 pos, float radius, Color32 color32, int edgeCount, float startAngle)
 {
-	ReservedDrawData drawData = PushVerts(&drawList, edgeCount * 3);
-	DrawIdx elemIdx = drawData.idxBuffer[0];
-	assert(drawList.vertCount <= drawList.maxVertCount);
+	RecordList* list = GetRecordList();
+	if (Renderer_IsInstancing() && edgeCount >= 3 && edgeCount <= RENDERER_MAX_POLYGON_EDGES)
+	{
+		ReserveInstances(list, 1);
+		PushInstance(list, pos, radius, color32, edgeCount, startAngle);
+		return;
+	}
+	TessellatePolygon(&list->drawList, pos, radius, color32, edgeCount, startAngle);
+}
+
+// Batches: strided views of the shape fields
+struct CircleArrays
+{
+	const char* pos;
+	const char* radius;
+	const char* color32;
+	const char* startAngle;	// NULL for 0
+	const char* edgeCounts;	// NULL for edgeCount
+	int posStride;
+	int floatStride;
+	int colorStride;
+	int intStride;
+	int edgeCount;
+};
+
+#define CIRCLE_FIELD(_ARRAYS, _FIELD, _TYPE, _STRIDE, _I)	(*(const _TYPE*)((_ARRAYS)->_FIELD + (size_t)(_ARRAYS)->_STRIDE * (_I)))
+
+static inline int CircleEdges(const CircleArrays* arrays, int i)
+{
+	return arrays->edgeCounts ? CIRCLE_FIELD(arrays, edgeCounts, int, intStride, i) : arrays->edgeCount;
+}
+
+static inline void TessellateCircle(DrawList* drawList, const CircleArrays* arrays, int i, int edgeCount)
+{
+	Vector2 pos = CIRCLE_FIELD(arrays, pos, Vector2, posStride, i);
+	float radius = CIRCLE_FIELD(arrays, radius, float, floatStride, i);
+	Color32 color32 = CIRCLE_FIELD(arrays, color32, Color32, colorStride, i);
+	float startAngle = arrays->startAngle ? CIRCLE_FIELD(arrays, startAngle, float, floatStride, i) : 0.0f;
+	TessellatePolygon(drawList, pos, radius, color32, edgeCount, startAngle);
+}
+
+#if defined(RENDER_AVX2)
+// Rows of 8 lanes to lanes of 8 rows: r[i] lane j goes to r[j] lane i
+static inline void Transpose8(__m256* r)
+{
+	__m256 t0 = _mm256_unpacklo_ps(r[0], r[1]);
+	__m256 t1 = _mm256_unpackhi_ps(r[0], r[1]);
+	__m256 t2 = _mm256_unpacklo_ps(r[2], r[3]);
+	__m256 t3 = _mm256_unpackhi_ps(r[2], r[3]);
+	__m256 t4 = _mm256_unpacklo_ps(r[4], r[5]);
+	__m256 t5 = _mm256_unpackhi_ps(r[4], r[5]);
+	__m256 t6 = _mm256_unpacklo_ps(r[6], r[7]);
+	__m256 t7 = _mm256_unpackhi_ps(r[6], r[7]);
+	__m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+	__m256 s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+	__m256 s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+	__m256 s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+	r[0] = _mm256_permute2f128_ps(s0, s4, 0x20);
+	r[1] = _mm256_permute2f128_ps(s1, s5, 0x20);
+	r[2] = _mm256_permute2f128_ps(s2, s6, 0x20);
+	r[3] = _mm256_permute2f128_ps(s3, s7, 0x20);
+	r[4] = _mm256_permute2f128_ps(s0, s4, 0x31);
+	r[5] = _mm256_permute2f128_ps(s1, s5, 0x31);
+	r[6] = _mm256_permute2f128_ps(s2, s6, 0x31);
+	r[7] = _mm256_permute2f128_ps(s3, s7, 0x31);
+}
+
+// 8 sincos at once: the quadrant from x * 2/pi, the remainder in [-pi/4, pi/4] (pi/2 split in three for
+// exact products) and the Cephes sinf and cosf polynomials, within a couple ulp of them for game angles
+static inline void SinCos8(__m256 x, __m256* sinX, __m256* cosX)
+{
+	__m256 q = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(2.0f / PI)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	__m256 r = _mm256_sub_ps(x, _mm256_mul_ps(q, _mm256_set1_ps(1.5703125f)));
+	r = _mm256_sub_ps(r, _mm256_mul_ps(q, _mm256_set1_ps(4.837512969970703125e-4f)));
+	r = _mm256_sub_ps(r, _mm256_mul_ps(q, _mm256_set1_ps(7.54978995489188216e-8f)));
+	__m256 r2 = _mm256_mul_ps(r, r);
+
+	__m256 sinR = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(-1.9515295891e-4f), r2), _mm256_set1_ps(8.3321608736e-3f));
+	sinR = _mm256_add_ps(_mm256_mul_ps(sinR, r2), _mm256_set1_ps(-1.6666654611e-1f));
+	sinR = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(sinR, r2), r), r);
+	__m256 cosR = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(2.443315711809948e-5f), r2), _mm256_set1_ps(-1.388731625493765e-3f));
+	cosR = _mm256_add_ps(_mm256_mul_ps(cosR, r2), _mm256_set1_ps(4.166664568298827e-2f));
+	cosR = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(cosR, r2), r2), _mm256_sub_ps(_mm256_set1_ps(1.0f), _mm256_mul_ps(_mm256_set1_ps(0.5f), r2)));
+
+	// Odd quadrants swap sin and cos, sin is negated in quadrants 2 and 3, cos in 1 and 2
+	__m256i quadrant = _mm256_cvtps_epi32(q);
+	__m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(quadrant, _mm256_set1_epi32(1)), _mm256_set1_epi32(1)));
+	__m256 sinSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(quadrant, _mm256_set1_epi32(2)), 30));
+	__m256 cosSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(_mm256_add_epi32(quadrant, _mm256_set1_epi32(1)), _mm256_set1_epi32(2)), 30));
+	*sinX = _mm256_xor_ps(_mm256_blendv_ps(sinR, cosR, swap), sinSign);
+	*cosX = _mm256_xor_ps(_mm256_blendv_ps(cosR, sinR, swap), cosSign);
+}
+
+// Copy into the draw list: non temporal when the chunk is a mapped GL buffer, likely write combined
+// memory, whole aligned 32 byte lines with only the unaligned head and tail as plain stores. Client arrays
+// are read back by the driver at the draw, streaming them out of the cache would only slow that down
+static void CopyToDrawList(const DrawList* drawList, void* dst, const void* src, int bytes)
+{
+	if (drawList->chunks[drawList->chunk].stream.path == STREAM_PATH_CLIENT_ARRAYS)
+	{
+		memcpy(dst, src, bytes);
+		return;
+	}
+	char* d = (char*)dst;
+	const char* s = (const char*)src;
+	int head = (int)((32 - ((uintptr_t)d & 31)) & 31);
+	if (head > bytes) head = bytes;
+	memcpy(d, s, head);
+	d += head; s += head; bytes -= head;
+	for (; bytes >= 32; bytes -= 32, d += 32, s += 32)
+	{
+		_mm256_stream_si256((__m256i*)d, _mm256_loadu_si256((const __m256i*)s));
+	}
+	memcpy(d, s, bytes);
+}
+
+// 8 n-gons of edgeCount edges: the rims are built in lanes of 8 shapes, transposed 8 words at a time
+// into the interleaved vertices of the 8 fans, the indices are the unit fan moved to each shape's center
+static void TessellateCircles8(DrawList* drawList, const CircleArrays* arrays, const int* order, int edgeCount)
+{
+	const int rowWords = 3 * (edgeCount + 1);	// x, y, color per vertex, center first
+	const int fanIdxs = 3 * edgeCount;
+	alignas(32) float rows[8 * 3 * (RENDERER_MAX_POLYGON_EDGES + 1) + 8];
+	alignas(32) DrawIdx idxs[8 * 3 * RENDERER_MAX_POLYGON_EDGES + 16];
+	__m256 columns[3 * (RENDERER_MAX_POLYGON_EDGES + 1) + 8];
+
+	__m256i lanes = _mm256_loadu_si256((const __m256i*)order);
+	__m256i posOffsets = _mm256_mullo_epi32(lanes, _mm256_set1_epi32(arrays->posStride));
+	__m256i floatOffsets = _mm256_mullo_epi32(lanes, _mm256_set1_epi32(arrays->floatStride));
+	__m256i colorOffsets = _mm256_mullo_epi32(lanes, _mm256_set1_epi32(arrays->colorStride));
+	__m256 px = _mm256_i32gather_ps((const float*)arrays->pos, posOffsets, 1);
+	__m256 py = _mm256_i32gather_ps((const float*)(arrays->pos + sizeof(float)), posOffsets, 1);
+	__m256 radius = _mm256_i32gather_ps((const float*)arrays->radius, floatOffsets, 1);
+	__m256 color = _mm256_castsi256_ps(_mm256_i32gather_epi32((const int*)arrays->color32, colorOffsets, 1));
+
+	__m256 c = radius;
+	__m256 s = _mm256_setzero_ps();
+	if (arrays->startAngle)
+	{
+		__m256 degrees = _mm256_i32gather_ps((const float*)arrays->startAngle, floatOffsets, 1);
+		__m256 sines, cosines;
+		SinCos8(_mm256_mul_ps(degrees, _mm256_set1_ps(PI / 180.0f)), &sines, &cosines);
+		c = _mm256_mul_ps(radius, cosines);
+		s = _mm256_mul_ps(radius, sines);
+	}
 
-	float theta = 360.0f / edgeCount;
-	Vector2 point0 = pos;
-	Vector2 v = radius * Rotate(VECTOR2_RIGHT, startAngle);
-	Vector2 point1 = point0 + v;
+	columns[0] = px; columns[1] = py; columns[2] = color;
+	const Vector2* rim = &unitRims[unitRimFirst[edgeCount]];
 	for (int i = 0; i < edgeCount; i++)
 	{
-		v = Rotate(v, theta);
-		Vector2 point2 = point0 + v;
+		__m256 ux = _mm256_set1_ps(rim[i].x);
+		__m256 uy = _mm256_set1_ps(rim[i].y);
+		columns[3 * i + 3] = _mm256_add_ps(px, _mm256_sub_ps(_mm256_mul_ps(c, ux), _mm256_mul_ps(s, uy)));
+		columns[3 * i + 4] = _mm256_add_ps(py, _mm256_add_ps(_mm256_mul_ps(s, ux), _mm256_mul_ps(c, uy)));
+		columns[3 * i + 5] = color;
+	}
+
+	// The last, partial block first: its stores run into the start of the next row, which the full
+	// blocks overwrite after
+	int blocks = (rowWords + 7) / 8;
+	for (int n = 0; n < blocks; n++)
+	{
+		int b = (n + blocks - 1) % blocks;
+		__m256 block[8];
+		memcpy(block, &columns[8 * b], sizeof(block));
+		Transpose8(block);
+		for (int k = 0; k < 8; k++)
+		{
+			_mm256_storeu_ps(&rows[k * rowWords + 8 * b], block[k]);
+		}
+	}
+
+	ReservedDrawData drawData = PushVerts(drawList, 8 * (edgeCount + 1), 8 * fanIdxs);
+
+	// 16 indices a step, the spill past a fan is overwritten by the next one
+	const DrawIdx* fan = &unitFans[3 * unitRimFirst[edgeCount]];
+	for (int k = 0; k < 8; k++)
+	{
+		__m256i centerIdx = _mm256_set1_epi16((short)(drawData.firstIdx + k * (edgeCount + 1)));
+		for (int i = 0; i < fanIdxs; i += 16)
+		{
+			__m256i unit = _mm256_loadu_si256((const __m256i*)&fan[i]);
+			_mm256_storeu_si256((__m256i*)&idxs[k * fanIdxs + i], _mm256_add_epi16(unit, centerIdx));
+		}
+	}
+
+	CopyToDrawList(drawList, drawData.vertBuffer, rows, sizeof(float) * 8 * rowWords);
+	CopyToDrawList(drawList, drawData.idxBuffer, idxs, sizeof(DrawIdx) * 8 * fanIdxs);
+}
+#endif
+
+void DrawCircles(const Vector2* pos, const float* radius, const Color32* color32, int count, int edgeCount, int stride,
+				 const float* startAngle, const int* edgeCounts)
+{
+	if (count <= 0) return;
+	CircleArrays arrays;
+	arrays.pos = (const char*)pos;
+	arrays.radius = (const char*)radius;
+	arrays.color32 = (const char*)color32;
+	arrays.startAngle = (const char*)startAngle;
+	arrays.edgeCounts = (const char*)edgeCounts;
+	arrays.posStride = stride ? stride : sizeof(Vector2);
+	arrays.floatStride = stride ? stride : sizeof(float);
+	arrays.colorStride = stride ? stride : sizeof(Color32);
+	arrays.intStride = stride ? stride : sizeof(int);
+	arrays.edgeCount = edgeCount;
+	RecordList* list = GetRecordList();
+
+	if (Renderer_IsInstancing())
+	{
+		ReserveInstances(list, count);
+		for (int i = 0; i < count; i++)
+		{
+			int e = CircleEdges(&arrays, i);
+			if (e < 3 || e > RENDERER_MAX_POLYGON_EDGES)
+			{
+				TessellateCircle(&list->drawList, &arrays, i, e);
+				continue;
+			}
+			PushInstance(list, CIRCLE_FIELD(&arrays, pos, Vector2, posStride, i), CIRCLE_FIELD(&arrays, radius, float, floatStride, i),
+						 CIRCLE_FIELD(&arrays, color32, Color32, colorStride, i), e,
+						 startAngle ? CIRCLE_FIELD(&arrays, startAngle, float, floatStride, i) : 0.0f);
+		}
+		return;
+	}
 
-		drawData.vertBuffer[i * 3 + 0].vert = point0; drawData.vertBuffer[i * 3 + 0].color32 = color32; drawData.idxBuffer[i * 3 + 0] = elemIdx + 0;
-		drawData.vertBuffer[i * 3 + 1].vert = point1; drawData.vertBuffer[i * 3 + 1].color32 = color32; drawData.idxBuffer[i * 3 + 1] = elemIdx + 1;
-		drawData.vertBuffer[i * 3 + 2].vert = point2; drawData.vertBuffer[i * 3 + 2].color32 = color32; drawData.idxBuffer[i * 3 + 2] = elemIdx + 2;
-		elemIdx += 3;
+	// Counting sort by edge count so that runs of 8 shapes share one rim.
+	// Edge counts past the cache are kept in the last bucket, shapes under 3 edges are dropped
+	if (count > list->batchOrderCapacity)
+	{
+		list->batchOrderCapacity = count;
+		list->batchOrder = (int*)realloc(list->batchOrder, sizeof(int) * list->batchOrderCapacity);
+	}
+	int* batchOrder = list->batchOrder;
+	int first[RENDERER_MAX_POLYGON_EDGES + 3] = {};
+	for (int i = 0; i < count; i++)
+	{
+		int e = CircleEdges(&arrays, i);
+		if (e < 3) continue;
+		int bucket = e <= RENDERER_MAX_POLYGON_EDGES ? e : RENDERER_MAX_POLYGON_EDGES + 1;
+		first[bucket + 1]++;
+	}
+	for (int b = 1; b <= RENDERER_MAX_POLYGON_EDGES + 2; b++)
+	{
+		first[b] += first[b - 1];
+	}
+	int cursor[RENDERER_MAX_POLYGON_EDGES + 2];
+	memcpy(cursor, first, sizeof(cursor));
+	for (int i = 0; i < count; i++)
+	{
+		int e = CircleEdges(&arrays, i);
+		if (e < 3) continue;
+		int bucket = e <= RENDERER_MAX_POLYGON_EDGES ? e : RENDERER_MAX_POLYGON_EDGES + 1;
+		batchOrder[cursor[bucket]++] = i;
+	}
 
-		point1 = point2;
+#if defined(RENDER_AVX2)
+	// The gathers take 32 bit byte offsets from the arrays
+	int maxStride = arrays.posStride;
+	if (arrays.floatStride > maxStride) maxStride = arrays.floatStride;
+	if (arrays.colorStride > maxStride) maxStride = arrays.colorStride;
+	bool gather = (int64_t)(count - 1) * maxStride <= INT32_MAX;
+#endif
+	for (int b = 3; b <= RENDERER_MAX_POLYGON_EDGES + 1; b++)
+	{
+		int j = first[b];
+#if defined(RENDER_AVX2)
+		if (gather && b <= RENDERER_MAX_POLYGON_EDGES && 8 * (b + 1) <= list->drawList.chunkVertCount)
+		{
+			for (; j + 8 <= first[b + 1]; j += 8)
+			{
+				TessellateCircles8(&list->drawList, &arrays, &batchOrder[j], b);
+			}
+		}
+#endif
+		for (; j < first[b + 1]; j++)
+		{
+			TessellateCircle(&list->drawList, &arrays, batchOrder[j], CircleEdges(&arrays, batchOrder[j]));
+		}
 	}
+#if defined(RENDER_AVX2)
+	_mm_sfence();
+#endif
+}
+
+const char* Renderer_GetBatchPath()
+{
+#if defined(RENDER_AVX2)
+	return "avx2";
+#else
+	return "scalar";
+#endif
 }
 
 void DrawCircle(Vector2 pos, float radius, Color32 color32, int edgeCount)
@@ -65,13 +1024,11 @@ void DrawCircle(Vector2 pos, float radius, Color32 color32, int edgeCount)
 
 void DrawTriangle(Vector2 point1, Vector2 point2, Vector2 point3, Color32 color32)
 {
-	ReservedDrawData drawData = PushVerts(&drawList, 3);
-	DrawIdx elemIdx = drawData.idxBuffer[0];
-	assert(drawList.vertCount <= drawList.maxVertCount);
+	ReservedDrawData drawData = PushVerts(&GetRecordList()->drawList, 3);
 
-	drawData.vertBuffer[0].vert = point1; drawData.vertBuffer[0].color32 = color32; drawData.idxBuffer[0] = elemIdx + 0;
-	drawData.vertBuffer[1].vert = point2; drawData.vertBuffer[1].color32 = color32; drawData.idxBuffer[1] = elemIdx + 1;
-	drawData.vertBuffer[2].vert = point3; drawData.vertBuffer[2].color32 = color32; drawData.idxBuffer[2] = elemIdx + 2;
+	drawData.vertBuffer[0].vert = point1; drawData.vertBuffer[0].color32 = color32;
+	drawData.vertBuffer[1].vert = point2; drawData.vertBuffer[1].color32 = color32;
+	drawData.vertBuffer[2].vert = point3; drawData.vertBuffer[2].color32 = color32;
 }
 
 //#define TIP_LENGTH 10.0f
@@ -1,6 +1,10 @@
 #pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <assert.h>
 #include "vector.h"
 #include "color.h"
+#include "renderqueue.h"
 
 struct DrawVert
 {
@@ -10,37 +14,136 @@ struct DrawVert
 
 typedef unsigned short DrawIdx;
 
+// Indices are 16 bit and relative to their chunk, a chunk holds at most this many vertices
+#define DRAW_CHUNK_MAX_VERTS	(UINT16_MAX + 1)
+
+// Room for the indices of fans: up to 3 per vertex
+#define DRAW_CHUNK_IDX_PER_VERT	3
+
+// Vertices and indices streamed to GL buffers (see streambuffer.h) in chunks of chunkVertCount,
+// drawn with one draw call per chunk. The chunks are allocated when a frame first needs them and
+// reused after, a shape is never split between two chunks.
+// A chunk of only sequential primitives (triangle or line lists) writes no indices and is drawn with
+// glDrawArrays. The first indexed shape pushed writes the indices of the ones before it.
 struct DrawList
 {
-	DrawVert* vertBuffer;
+	DrawVert* vertBuffer;	// of the chunk being filled
 	DrawIdx* idxBuffer;
-	unsigned short vertCount;
-	unsigned short maxVertCount;
+	int vertCount;
+	int maxVertCount;
+	int idxCount;			// written, or that would be if the chunk was indexed
+	int maxIdxCount;
+	bool indexed;
+	int chunkVertCount;
+	int chunk;				// being filled
+	int chunkCount;			// allocated
+	struct DrawChunk* chunks;
+	bool clientArrays;		// chunks in plain memory, the list can be filled on any thread
 };
 
 struct ReservedDrawData
 {
 	DrawVert* vertBuffer;
-	DrawIdx* idxBuffer;
+	DrawIdx* idxBuffer;	// NULL for sequential primitives
+	DrawIdx firstIdx;	// index of vertBuffer[0], the buffers can be mapped GPU memory that is slow to read
+};
+
+// Primitive modes of DrawList_Draw, the GL values so that the GL draws take them as they are
+#define DRAW_MODE_LINES		0x0001	// GL_LINES
+#define DRAW_MODE_TRIANGLES	0x0004	// GL_TRIANGLES
+
+void DrawList_Init(DrawList* drawList, int chunkVertCount, bool clientArrays = false); // needs GlApi_Load unless clientArrays
+void DrawList_Begin(DrawList* drawList);	// empties the list, points it at this frame's buffers
+void DrawList_NextChunk(DrawList* drawList);
+void DrawList_IndexChunk(DrawList* drawList);
+void DrawList_Draw(DrawList* drawList, unsigned int mode); // a DRAW_MODE_
+// Where DrawList_Draw sends the chunks instead of GL, for the software renderer (softrender.h). The lists
+// must then be in plain memory (no GlApi_Load, or StreamBuffer_SetMaxPath(STREAM_PATH_CLIENT_ARRAYS)).
+// idxs is NULL for the chunks drawn with glDrawArrays. While one is set the renderer tessellates every
+// n-gon, instancing needs GL
+typedef void (*DrawChunkFunc)(const DrawVert* verts, int vertCount, const DrawIdx* idxs, int idxCount, unsigned int mode);
+void DrawList_SetDrawFunc(DrawChunkFunc func); // NULL draws with GL
+DrawChunkFunc DrawList_GetDrawFunc();
+int DrawList_GetVertCount(const DrawList* drawList);
+int DrawList_GetIdxCount(const DrawList* drawList); // written, without the glDrawArrays chunks
+
+struct RendererStats
+{
+	int vertices;		// tessellated on the CPU
+	int instances;		// n-gons drawn from the cached unit meshes
+	int uploadBytes;	// vertices, indices and instance records written for the GPU
+	int drawCalls;
 };
 
-void Renderer_Init(int maxVertCount);
-void Renderer_NewFrame();
+// The draw lists point into GL buffer memory (see streambuffer.h) from Renderer_NewFrame until
+// Renderer_Render, shapes must be pushed in between. There is one list per layer (see renderqueue.h),
+// Renderer_Render pushes their draws to the render queue and RenderQueue_Submit issues them.
+// N-gons of 3 to RENDERER_MAX_POLYGON_EDGES edges are built from a cached unit polygon per edge count.
+// With instancing they are drawn as instances of one fan mesh and only a 24 byte record per shape is
+// uploaded. Shapes keep the order they were pushed in: the n-gons pushed between two tessellated shapes
+// make one instanced draw call, which splits the draw of the tessellated shapes of the layer. Without
+// instancing (no GL 3.3 / ARB_instanced_arrays, or the shader failed) the unit polygon is scaled, rotated
+// and moved on the CPU.
+#define RENDERER_MAX_POLYGON_EDGES	32
+
+void Renderer_Init(int chunkVertCount, bool instancing = true); // needs GlApi_Load
+void Renderer_NewFrame(); // the layer goes back to RENDER_LAYER_WORLD
+void Renderer_SetLayer(RenderLayer layer); // main thread, not while lists are recorded: of the shapes pushed next
 void Renderer_Render();
+const char* Renderer_GetStreamPath();
+bool Renderer_IsInstancing(); // false while a DrawChunkFunc is set
+const RendererStats* Renderer_GetStats(); // of the last Renderer_Render
+
+// Recording lists, to push shapes from several threads at once. A thread pushes to the list it began,
+// or to the list of the current layer outside of Renderer_BeginList/EndList. Lists are in plain memory
+// (worker threads have no GL context) and Renderer_Render merges them after the list of the layer they
+// were added in, in list index order whatever thread filled them, so a frame comes out the same for any
+// thread count. A list is only filled by one thread at a time.
+int Renderer_AddLists(int count); // main thread, not while lists are recorded: index of the first of count lists
+void Renderer_BeginList(int list);
+void Renderer_EndList();
 
-static inline ReservedDrawData PushVerts(DrawList* drawList, int count)
+// idxCount 0 for sequential primitives, the caller only writes the vertices
+static inline ReservedDrawData PushVerts(DrawList* drawList, int vertCount, int idxCount = 0)
 {
+	int idxReserved = idxCount > 0 ? idxCount : vertCount;
+	assert(vertCount <= drawList->chunkVertCount && idxReserved <= drawList->chunkVertCount * DRAW_CHUNK_IDX_PER_VERT);
+	if (drawList->vertCount + vertCount > drawList->maxVertCount || drawList->idxCount + idxReserved > drawList->maxIdxCount)
+	{
+		DrawList_NextChunk(drawList);
+	}
+
 	DrawVert* vertBuff = &drawList->vertBuffer[drawList->vertCount];
-	DrawIdx* idxBuff = &drawList->idxBuffer[drawList->vertCount];
-	idxBuff[0] = drawList->vertCount;
+	DrawIdx firstIdx = drawList->vertCount;
+	DrawIdx* idxBuff = NULL;
+	if (idxCount > 0)
+	{
+		if (!drawList->indexed) DrawList_IndexChunk(drawList);
+		idxBuff = &drawList->idxBuffer[drawList->idxCount];
+	}
+	else if (drawList->indexed)
+	{
+		DrawIdx* seqBuff = &drawList->idxBuffer[drawList->idxCount];
+		for (int i = 0; i < vertCount; i++)
+		{
+			seqBuff[i] = firstIdx + i;
+		}
+	}
 
-	drawList->vertCount += count;
+	drawList->vertCount += vertCount;
+	drawList->idxCount += idxReserved;
 
-	ReservedDrawData resDrawData = { vertBuff, idxBuff };
+	ReservedDrawData resDrawData = { vertBuff, idxBuff, firstIdx };
 	return resDrawData;
 }
 
 void DrawCircle(Vector2 pos, float radius, Color32 color32, int edgeCount = 8);
 void DrawCircleWStartAngle(Vector2 pos, float radius, Color32 color32, int edgeCount, float startAngle);
+// count n-gons from arrays, or from fields of an array of structs with their byte stride (0 for tightly
+// packed arrays). startAngle (degrees) and edgeCounts can be NULL for 0 and edgeCount for all.
+// Tessellated, they are sorted by edge count and built 8 at a time with AVX2 where the build has it.
+void DrawCircles(const Vector2* pos, const float* radius, const Color32* color32, int count, int edgeCount, int stride = 0,
+				 const float* startAngle = NULL, const int* edgeCounts = NULL);
+const char* Renderer_GetBatchPath(); // "avx2" or "scalar"
 void DrawTriangle(Vector2 point1, Vector2 point2, Vector2 point3, Color32 color32);
 //void DrawVectorImmediate(Vector2 v, Vector2 pos);
\ No newline at end of file
@@ -0,0 +1,129 @@
+#include <string.h>
+#include <stdlib.h>
+#include <assert.h>
+#include "renderqueue.h"
+
+#define RENDER_QUEUE_MIN_COMMANDS	64
+
+struct RenderCommand
+{
+	uint64_t key;
+	RenderCommandFunc func;
+	void* context;
+};
+
+struct PrimitiveState
+{
+	RenderStateFunc begin;
+	RenderStateFunc end;
+};
+
+static RenderCommand* commands;
+static RenderCommand* sortScratch;
+static int commandCount;
+static int maxCommandCount;	// grows when a frame has more
+static PrimitiveState primitiveStates[RENDER_PRIMITIVE_COUNT];
+static RenderQueueStats stats;
+
+void RenderQueue_SetPrimitiveState(RenderPrimitive primitive, RenderStateFunc begin, RenderStateFunc end)
+{
+	primitiveStates[primitive].begin = begin;
+	primitiveStates[primitive].end = end;
+}
+
+void RenderQueue_Push(uint64_t key, RenderCommandFunc func, void* context)
+{
+	if (commandCount == maxCommandCount)
+	{
+		maxCommandCount = maxCommandCount ? 2 * maxCommandCount : RENDER_QUEUE_MIN_COMMANDS;
+		commands = (RenderCommand*)realloc(commands, sizeof(RenderCommand) * maxCommandCount);
+		sortScratch = (RenderCommand*)realloc(sortScratch, sizeof(RenderCommand) * maxCommandCount);
+		assert(commands && sortScratch);
+	}
+	RenderCommand* command = &commands[commandCount++];
+	command->key = key;
+	command->func = func;
+	command->context = context;
+}
+
+// LSD radix sort on the keys, a byte per pass. The histograms of every byte are counted in one go and the
+// passes where all keys share the byte are skipped, most frames only sort on the layer and primitive bytes
+static void SortCommands()
+{
+	int histograms[8][256];
+	memset(histograms, 0, sizeof(histograms));
+	for (int i = 0; i < commandCount; i++)
+	{
+		uint64_t key = commands[i].key;
+		for (int b = 0; b < 8; b++)
+		{
+			histograms[b][(key >> (8 * b)) & 0xff]++;
+		}
+	}
+
+	RenderCommand* src = commands;
+	RenderCommand* dst = sortScratch;
+	for (int b = 0; b < 8; b++)
+	{
+		int* histogram = histograms[b];
+		if (histogram[(src[0].key >> (8 * b)) & 0xff] == commandCount) continue;
+
+		int offset = 0;
+		for (int d = 0; d < 256; d++)
+		{
+			int count = histogram[d];
+			histogram[d] = offset;
+			offset += count;
+		}
+		for (int i = 0; i < commandCount; i++)
+		{
+			dst[histogram[(src[i].key >> (8 * b)) & 0xff]++] = src[i];
+		}
+		RenderCommand* tmp = src;
+		src = dst;
+		dst = tmp;
+	}
+	if (src != commands)
+	{
+		memcpy(commands, src, sizeof(RenderCommand) * commandCount);
+	}
+}
+
+static void EndState(uint64_t state)
+{
+	RenderStateFunc end = primitiveStates[state >> 48].end;
+	if (end) end((unsigned int)(state >> 32) & 0xffff);
+}
+
+void RenderQueue_Submit()
+{
+	memset(&stats, 0, sizeof(stats));
+	stats.commands = commandCount;
+	if (commandCount == 0) return;
+	SortCommands();
+
+	uint64_t state = 0;
+	bool inState = false;
+	for (int i = 0; i < commandCount; i++)
+	{
+		RenderCommand* command = &commands[i];
+		uint64_t commandState = command->key & RENDER_KEY_STATE_MASK;
+		if (!inState || commandState != state)
+		{
+			if (inState) EndState(state);
+			state = commandState;
+			inState = true;
+			stats.stateChanges++;
+			RenderStateFunc begin = primitiveStates[state >> 48].begin;
+			if (begin) begin((unsigned int)(state >> 32) & 0xffff);
+		}
+		command->func(command->context);
+	}
+	EndState(state);
+	commandCount = 0;
+}
+
+const RenderQueueStats* RenderQueue_GetStats()
+{
+	return &stats;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <stdint.h>
+
+// Draw commands of a frame, issued in the order of a 64 bit sort key instead of the order they were
+// pushed. From the high bits: the layer, then the primitive and the texture so that commands sharing
+// GL state run together, then the depth, lower first. The sort is stable, commands with equal keys run
+// in push order.
+// Key bits: 63..56 layer, 55..48 primitive, 47..32 texture, 31..16 depth, 15..0 unused
+
+enum RenderLayer
+{
+	RENDER_LAYER_BACKGROUND = 0,
+	RENDER_LAYER_WORLD,
+	RENDER_LAYER_DEBUG,
+	RENDER_LAYER_UI,
+	RENDER_LAYER_COUNT,
+};
+
+enum RenderPrimitive
+{
+	RENDER_PRIMITIVE_TRIANGLES = 0,	// the renderer's layers, with their instanced n-gons in between
+	RENDER_PRIMITIVE_LINES,
+	RENDER_PRIMITIVE_TEXT,			// textured quads
+	RENDER_PRIMITIVE_COUNT,
+};
+
+#define RENDER_KEY(_LAYER, _PRIMITIVE, _TEXTURE, _DEPTH)	(((uint64_t)(_LAYER) << 56) | ((uint64_t)(_PRIMITIVE) << 48) | \
+															 ((uint64_t)((_TEXTURE) & 0xffff) << 32) | ((uint64_t)((_DEPTH) & 0xffff) << 16))
+#define RENDER_KEY_STATE_MASK	0x00ffffff00000000ULL	// primitive and texture
+
+typedef void (*RenderCommandFunc)(void* context);
+// GL state of a primitive: begin before the first command of a run of the same primitive and texture,
+// end after its last one. The state between runs is the one main sets up, vertex and color arrays on.
+typedef void (*RenderStateFunc)(unsigned int texture);
+
+struct RenderQueueStats
+{
+	int commands;
+	int stateChanges;	// runs of primitive and texture
+};
+
+void RenderQueue_SetPrimitiveState(RenderPrimitive primitive, RenderStateFunc begin, RenderStateFunc end); // either can be NULL
+void RenderQueue_Push(uint64_t key, RenderCommandFunc func, void* context);
+void RenderQueue_Submit(); // sorts and runs the commands pushed since the last submit
+const RenderQueueStats* RenderQueue_GetStats(); // of the last submit
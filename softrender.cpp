@@ -0,0 +1,702 @@
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <assert.h>
+#include <chrono>
+#include "softrender.h"
+#include "jobs.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SOFTRENDER_SSE2
+#endif
+
+#define SOFT_MIN(_A, _B)	((_A) < (_B) ? (_A) : (_B))
+#define SOFT_MAX(_A, _B)	((_A) > (_B) ? (_A) : (_B))
+
+#define SOFT_SUBPIXEL_BITS	8
+#define SOFT_SUBPIXEL		(1 << SOFT_SUBPIXEL_BITS)
+#define SOFT_BLOCK_SIZE		8			// pixels, the tiles are walked in square blocks
+#define SOFT_BIN_BATCH		1024		// primitives binned per job
+#define SOFT_MIN_PRIMS		1024
+#define SOFT_MAX_COORD		1048576.0f	// pixels, vertices are clamped to it so the edge functions fit 64 bits
+// |a| + |b| of the edges stepped in 32 bits across a block, triangles with longer edges are walked in 64 bits
+#define SOFT_MAX_EDGE_STEP	(1 << 20)
+
+enum SoftPrimType
+{
+	SOFT_PRIM_TRIANGLE = 0,
+	SOFT_PRIM_LINE,
+};
+
+struct SoftPrim
+{
+	DrawVert verts[3];	// 2 for lines
+	int type;
+};
+
+// Filled in when the primitive is binned
+struct SoftSetup
+{
+	int minX, minY, maxX, maxY;	// pixels it can cover, inside the framebuffer, empty when minX > maxX
+	int a[3], b[3];				// triangle edges: a * x + b * y + c of the subpixel sample position, >= 0 inside
+	int64_t c[3];				// with the fill rule bias
+	bool flat;					// one color
+	bool wide;					// an edge past SOFT_MAX_EDGE_STEP
+	float planes[4][3];			// color channels of the other triangles: per pixel x and y gradients, value at minX, minY
+};
+
+// The primitives of one bin job, by tile
+struct SoftBin
+{
+	int* tileStart;		// tileCount + 1
+	int* items;			// primitive indices
+	int itemCapacity;
+};
+
+static SoftFramebuffer framebuffer;
+static int tilesX;
+static int tilesY;
+static SoftPrim* prims;			// drawn since the last flush
+static SoftSetup* setups;
+static int primCount;
+static int maxPrimCount;		// grows when a frame has more
+static int triangleCount;
+static int lineCount;
+static SoftBin* bins;
+static int binCount;			// of this flush
+static int binCapacity;			// allocated
+static bool clearPending;
+static Color32 clearColor;
+static SoftRendererStats stats;
+
+void SoftRenderer_Init(int width, int height)
+{
+	assert(width > 0 && height > 0 && framebuffer.pixels == NULL);
+	memset(&stats, 0, sizeof(stats));
+	// Rows and columns padded to whole blocks, the blocks at the right and top edges are written whole
+	framebuffer.width = width;
+	framebuffer.height = height;
+	framebuffer.stride = (width + SOFT_BLOCK_SIZE - 1) / SOFT_BLOCK_SIZE * SOFT_BLOCK_SIZE;
+	int paddedHeight = (height + SOFT_BLOCK_SIZE - 1) / SOFT_BLOCK_SIZE * SOFT_BLOCK_SIZE;
+	framebuffer.pixels = (Color32*)calloc((size_t)framebuffer.stride * paddedHeight, sizeof(Color32));
+	tilesX = (width + SOFT_TILE_SIZE - 1) / SOFT_TILE_SIZE;
+	tilesY = (height + SOFT_TILE_SIZE - 1) / SOFT_TILE_SIZE;
+	primCount = 0;
+	triangleCount = 0;
+	lineCount = 0;
+	clearPending = false;
+	DrawList_SetDrawFunc(SoftRenderer_DrawChunk);
+}
+
+void SoftRenderer_Shutdown()
+{
+	DrawList_SetDrawFunc(NULL);
+	for (int b = 0; b < binCapacity; b++)
+	{
+		free(bins[b].tileStart);
+		free(bins[b].items);
+	}
+	free(bins);
+	free(prims);
+	free(setups);
+	free(framebuffer.pixels);
+	bins = NULL;
+	binCapacity = 0;
+	prims = NULL;
+	setups = NULL;
+	maxPrimCount = 0;
+	memset(&framebuffer, 0, sizeof(framebuffer));
+}
+
+void SoftRenderer_Clear(Color32 color32)
+{
+	// What was drawn before would be cleared over
+	primCount = 0;
+	triangleCount = 0;
+	lineCount = 0;
+	clearPending = true;
+	clearColor = color32;
+}
+
+void SoftRenderer_DrawChunk(const DrawVert* verts, int vertCount, const DrawIdx* idxs, int idxCount, unsigned int mode)
+{
+	assert(mode == DRAW_MODE_TRIANGLES || mode == DRAW_MODE_LINES);
+	int primVerts = mode == DRAW_MODE_TRIANGLES ? 3 : 2;
+	int count = (idxs ? idxCount : vertCount) / primVerts;
+	if (primCount + count > maxPrimCount)
+	{
+		if (maxPrimCount == 0) maxPrimCount = SOFT_MIN_PRIMS;
+		while (primCount + count > maxPrimCount) maxPrimCount *= 2;
+		prims = (SoftPrim*)realloc(prims, sizeof(SoftPrim) * maxPrimCount);
+		setups = (SoftSetup*)realloc(setups, sizeof(SoftSetup) * maxPrimCount);
+		assert(prims && setups);
+	}
+
+	for (int p = 0; p < count; p++)
+	{
+		SoftPrim* prim = &prims[primCount + p];
+		prim->type = mode == DRAW_MODE_TRIANGLES ? SOFT_PRIM_TRIANGLE : SOFT_PRIM_LINE;
+		for (int v = 0; v < primVerts; v++)
+		{
+			int i = p * primVerts + v;
+			prim->verts[v] = verts[idxs ? idxs[i] : i];
+		}
+	}
+	primCount += count;
+	if (mode == DRAW_MODE_TRIANGLES) triangleCount += count;
+	else lineCount += count;
+}
+
+static inline float ClampCoord(float v)
+{
+	if (!(v > -SOFT_MAX_COORD)) return -SOFT_MAX_COORD; // NaN too
+	return v < SOFT_MAX_COORD ? v : SOFT_MAX_COORD;
+}
+
+static inline int SnapCoord(float v)
+{
+	return (int)floorf(ClampCoord(v) * SOFT_SUBPIXEL + 0.5f);
+}
+
+static inline int Min3(int a, int b, int c) { return SOFT_MIN(a, SOFT_MIN(b, c)); }
+static inline int Max3(int a, int b, int c) { return SOFT_MAX(a, SOFT_MAX(b, c)); }
+
+static void SetupTriangle(const SoftPrim* prim, SoftSetup* setup)
+{
+	setup->minX = 1;
+	setup->maxX = 0;
+
+	// Counterclockwise, so that the inside is where every edge function is positive
+	int x[3], y[3];
+	int order[3] = { 0, 1, 2 };
+	for (int v = 0; v < 3; v++)
+	{
+		x[v] = SnapCoord(prim->verts[v].vert.x);
+		y[v] = SnapCoord(prim->verts[v].vert.y);
+	}
+	int64_t area = (int64_t)(x[1] - x[0]) * (y[2] - y[0]) - (int64_t)(y[1] - y[0]) * (x[2] - x[0]);
+	if (area == 0) return;
+	if (area < 0)
+	{
+		order[1] = 2;
+		order[2] = 1;
+		area = -area;
+	}
+
+	// Pixels whose center is inside the bounds
+	const int half = SOFT_SUBPIXEL / 2;
+	setup->minX = SOFT_MAX(0, (Min3(x[0], x[1], x[2]) - half + SOFT_SUBPIXEL - 1) >> SOFT_SUBPIXEL_BITS);
+	setup->minY = SOFT_MAX(0, (Min3(y[0], y[1], y[2]) - half + SOFT_SUBPIXEL - 1) >> SOFT_SUBPIXEL_BITS);
+	setup->maxX = SOFT_MIN(framebuffer.width - 1, (Max3(x[0], x[1], x[2]) - half) >> SOFT_SUBPIXEL_BITS);
+	setup->maxY = SOFT_MIN(framebuffer.height - 1, (Max3(y[0], y[1], y[2]) - half) >> SOFT_SUBPIXEL_BITS);
+	if (setup->minX > setup->maxX || setup->minY > setup->maxY) return;
+
+	setup->wide = false;
+	for (int e = 0; e < 3; e++)
+	{
+		int va = order[e];
+		int vb = order[(e + 1) % 3];
+		int a = y[va] - y[vb];
+		int b = x[vb] - x[va];
+		setup->a[e] = a;
+		setup->b[e] = b;
+		setup->c[e] = -((int64_t)a * x[va] + (int64_t)b * y[va]);
+		// A sample on an edge shared by two triangles goes to one of them: the edge runs the other way in
+		// the second one, so only one side keeps the samples where the edge function is 0
+		if (!(a > 0 || (a == 0 && b > 0))) setup->c[e] -= 1;
+		if (abs(a) + abs(b) >= SOFT_MAX_EDGE_STEP) setup->wide = true;
+	}
+
+	Color32 c0 = prim->verts[order[0]].color32;
+	Color32 c1 = prim->verts[order[1]].color32;
+	Color32 c2 = prim->verts[order[2]].color32;
+	setup->flat = c0 == c1 && c0 == c2;
+	if (setup->flat) return;
+
+	// Barycentric weights of vertices 1 and 2 are the edge functions of edges 2 and 0 over the area
+	double sampleX = (double)setup->minX * SOFT_SUBPIXEL + half;
+	double sampleY = (double)setup->minY * SOFT_SUBPIXEL + half;
+	double w1 = ((double)setup->a[2] * sampleX + (double)setup->b[2] * sampleY + (double)(setup->c[2])) / (double)area;
+	double w2 = ((double)setup->a[0] * sampleX + (double)setup->b[0] * sampleY + (double)(setup->c[0])) / (double)area;
+	for (int ch = 0; ch < 4; ch++)
+	{
+		int s = 8 * ch;
+		double v0 = (c0 >> s) & 0xff;
+		double d1 = (double)((c1 >> s) & 0xff) - v0;
+		double d2 = (double)((c2 >> s) & 0xff) - v0;
+		setup->planes[ch][0] = (float)((d1 * setup->a[2] + d2 * setup->a[0]) * SOFT_SUBPIXEL / (double)area);
+		setup->planes[ch][1] = (float)((d1 * setup->b[2] + d2 * setup->b[0]) * SOFT_SUBPIXEL / (double)area);
+		setup->planes[ch][2] = (float)(v0 + d1 * w1 + d2 * w2);
+	}
+}
+
+// Lines in subpixels, along their major axis
+struct SoftLine
+{
+	bool xMajor;
+	int major0, major1;
+	int minor0, minor1;
+	int first, last;	// pixels along the major axis
+};
+
+// Whether the point is inside the diamond |dx| + |dy| < 1/2 around the center of its pixel
+static inline bool InDiamond(int major, int minor)
+{
+	return abs((major & (SOFT_SUBPIXEL - 1)) - SOFT_SUBPIXEL / 2) + abs((minor & (SOFT_SUBPIXEL - 1)) - SOFT_SUBPIXEL / 2) < SOFT_SUBPIXEL / 2;
+}
+
+// GL's diamond exit rule: a pixel is drawn when the line leaves the diamond inside it, so 1 per step of
+// the major axis, where the line crosses the pixel centers. The first pixel is drawn when the line
+// starts in its diamond even past its center, the last one isn't when the line ends in its diamond
+static bool SnapLine(const SoftPrim* prim, SoftLine* line)
+{
+	int x0 = SnapCoord(prim->verts[0].vert.x), y0 = SnapCoord(prim->verts[0].vert.y);
+	int x1 = SnapCoord(prim->verts[1].vert.x), y1 = SnapCoord(prim->verts[1].vert.y);
+	line->xMajor = abs(x1 - x0) >= abs(y1 - y0);
+	line->major0 = line->xMajor ? x0 : y0;
+	line->major1 = line->xMajor ? x1 : y1;
+	line->minor0 = line->xMajor ? y0 : x0;
+	line->minor1 = line->xMajor ? y1 : x1;
+	if (line->major0 == line->major1) return false;
+
+	const int half = SOFT_SUBPIXEL / 2;
+	int frac0 = line->major0 & (SOFT_SUBPIXEL - 1);
+	int frac1 = line->major1 & (SOFT_SUBPIXEL - 1);
+	if (line->major0 < line->major1)
+	{
+		// Centers in [major0, major1)
+		line->first = (line->major0 + half - 1) >> SOFT_SUBPIXEL_BITS;
+		line->last = ((line->major1 + half - 1) >> SOFT_SUBPIXEL_BITS) - 1;
+		if (frac0 > half && InDiamond(line->major0, line->minor0)) line->first--;
+		if (frac1 > half && InDiamond(line->major1, line->minor1)) line->last--;
+	}
+	else
+	{
+		// Centers in (major1, major0]
+		line->first = ((line->major1 - half) >> SOFT_SUBPIXEL_BITS) + 1;
+		line->last = (line->major0 - half) >> SOFT_SUBPIXEL_BITS;
+		if (frac0 < half && InDiamond(line->major0, line->minor0)) line->last++;
+		if (frac1 < half && InDiamond(line->major1, line->minor1)) line->first++;
+	}
+	return line->first <= line->last;
+}
+
+static void SetupLine(const SoftPrim* prim, SoftSetup* setup)
+{
+	setup->minX = 1;
+	setup->maxX = 0;
+	SoftLine line;
+	if (!SnapLine(prim, &line)) return;
+
+	// The minor axis is between the ends, give or take the half pixel to the outer centers
+	int minMinor = (SOFT_MIN(line.minor0, line.minor1) - SOFT_SUBPIXEL / 2) >> SOFT_SUBPIXEL_BITS;
+	int maxMinor = (SOFT_MAX(line.minor0, line.minor1) + SOFT_SUBPIXEL / 2) >> SOFT_SUBPIXEL_BITS;
+	setup->minX = SOFT_MAX(0, line.xMajor ? line.first : minMinor);
+	setup->minY = SOFT_MAX(0, line.xMajor ? minMinor : line.first);
+	setup->maxX = SOFT_MIN(framebuffer.width - 1, line.xMajor ? line.last : maxMinor);
+	setup->maxY = SOFT_MIN(framebuffer.height - 1, line.xMajor ? maxMinor : line.last);
+	setup->flat = prim->verts[0].color32 == prim->verts[1].color32;
+}
+
+static void BinPrims(void* context, int begin, int end, int threadIndex)
+{
+	int tileCount = tilesX * tilesY;
+	for (int first = begin; first < end; first += SOFT_BIN_BATCH)
+	{
+		int last = SOFT_MIN(first + SOFT_BIN_BATCH, end);
+		SoftBin* bin = &bins[first / SOFT_BIN_BATCH];
+		int* tileStart = bin->tileStart;
+		memset(tileStart, 0, sizeof(int) * (tileCount + 1));
+
+		int itemCount = 0;
+		for (int p = first; p < last; p++)
+		{
+			SoftSetup* setup = &setups[p];
+			if (prims[p].type == SOFT_PRIM_TRIANGLE) SetupTriangle(&prims[p], setup);
+			else SetupLine(&prims[p], setup);
+			if (setup->minX > setup->maxX || setup->minY > setup->maxY) continue;
+			for (int ty = setup->minY / SOFT_TILE_SIZE; ty <= setup->maxY / SOFT_TILE_SIZE; ty++)
+			{
+				for (int tx = setup->minX / SOFT_TILE_SIZE; tx <= setup->maxX / SOFT_TILE_SIZE; tx++)
+				{
+					tileStart[ty * tilesX + tx]++;
+					itemCount++;
+				}
+			}
+		}
+		if (itemCount > bin->itemCapacity)
+		{
+			bin->itemCapacity = SOFT_MAX(itemCount, 2 * bin->itemCapacity);
+			bin->items = (int*)realloc(bin->items, sizeof(int) * bin->itemCapacity);
+			assert(bin->items);
+		}
+
+		// Starts, then moved to the ends as the items are written, then shifted back to the starts
+		int offset = 0;
+		for (int t = 0; t < tileCount; t++)
+		{
+			int count = tileStart[t];
+			tileStart[t] = offset;
+			offset += count;
+		}
+		for (int p = first; p < last; p++)
+		{
+			const SoftSetup* setup = &setups[p];
+			if (setup->minX > setup->maxX || setup->minY > setup->maxY) continue;
+			for (int ty = setup->minY / SOFT_TILE_SIZE; ty <= setup->maxY / SOFT_TILE_SIZE; ty++)
+			{
+				for (int tx = setup->minX / SOFT_TILE_SIZE; tx <= setup->maxX / SOFT_TILE_SIZE; tx++)
+				{
+					bin->items[tileStart[ty * tilesX + tx]++] = p;
+				}
+			}
+		}
+		memmove(tileStart + 1, tileStart, sizeof(int) * tileCount);
+		tileStart[0] = 0;
+	}
+}
+
+// x / 255 rounded to the nearest, for x up to 255 * 255
+static inline unsigned int DivRound255(unsigned int x)
+{
+	x += 128;
+	return (x + (x >> 8)) >> 8;
+}
+
+// src * a + dst * (1 - a) per 8 bit channel, both products rounded before the sum like Mesa's llvmpipe,
+// so frames match the software GL a machine without a GPU would run
+static inline Color32 BlendPixel(Color32 src, Color32 dst)
+{
+	unsigned int alpha = src >> 24;
+	Color32 result = 0;
+	for (int s = 0; s < 32; s += 8)
+	{
+		result |= (DivRound255(((src >> s) & 0xff) * alpha) + DivRound255(((dst >> s) & 0xff) * (255 - alpha))) << s;
+	}
+	return result;
+}
+
+static inline Color32 PlaneColor(const SoftSetup* setup, int x, int y)
+{
+	float dx = (float)(x - setup->minX);
+	float dy = (float)(y - setup->minY);
+	Color32 color32 = 0;
+	for (int ch = 0; ch < 4; ch++)
+	{
+		float v = setup->planes[ch][2] + setup->planes[ch][0] * dx + setup->planes[ch][1] * dy;
+		v = fminf(fmaxf(v, 0.0f), 255.0f);
+		color32 |= (Color32)(int)(v + 0.5f) << (8 * ch);
+	}
+	return color32;
+}
+
+// Edge functions in 64 bits per pixel: the blocks of wide triangles, or everything without SSE2
+static void DrawBlockScalar(const SoftPrim* prim, const SoftSetup* setup, int blockX, int blockY)
+{
+	for (int y = blockY; y < blockY + SOFT_BLOCK_SIZE; y++)
+	{
+		Color32* row = &framebuffer.pixels[(size_t)y * framebuffer.stride];
+		int64_t sampleY = ((int64_t)y << SOFT_SUBPIXEL_BITS) + SOFT_SUBPIXEL / 2;
+		for (int x = blockX; x < blockX + SOFT_BLOCK_SIZE; x++)
+		{
+			int64_t sampleX = ((int64_t)x << SOFT_SUBPIXEL_BITS) + SOFT_SUBPIXEL / 2;
+			bool inside = true;
+			for (int e = 0; e < 3; e++)
+			{
+				if (setup->a[e] * sampleX + setup->b[e] * sampleY + setup->c[e] < 0) inside = false;
+			}
+			if (!inside) continue;
+			Color32 src = setup->flat ? prim->verts[0].color32 : PlaneColor(setup, x, y);
+			row[x] = BlendPixel(src, row[x]);
+		}
+	}
+}
+
+#if defined(SOFTRENDER_SSE2)
+// Like DivRound255, on 16 bit lanes
+static inline __m128i DivRound255Wide(__m128i x)
+{
+	x = _mm_add_epi16(x, _mm_set1_epi16(128));
+	return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+// 2 pixels widened to 16 bits per channel, with src * a and 255 - a given, like BlendPixel
+static inline __m128i BlendWide(__m128i srcTerm, __m128i invAlpha, __m128i dst)
+{
+	return _mm_add_epi16(srcTerm, DivRound255Wide(_mm_mullo_epi16(dst, invAlpha)));
+}
+
+static inline void BlendTerms(__m128i src, __m128i* srcTerm, __m128i* invAlpha)
+{
+	__m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(src, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+	*srcTerm = DivRound255Wide(_mm_mullo_epi16(src, alpha));
+	*invAlpha = _mm_sub_epi16(_mm_set1_epi16(255), alpha);
+}
+
+// 4 pixels
+static inline __m128i Blend4(__m128i src, __m128i dst)
+{
+	__m128i zero = _mm_setzero_si128();
+	__m128i srcTermLo, invAlphaLo, srcTermHi, invAlphaHi;
+	BlendTerms(_mm_unpacklo_epi8(src, zero), &srcTermLo, &invAlphaLo);
+	BlendTerms(_mm_unpackhi_epi8(src, zero), &srcTermHi, &invAlphaHi);
+	return _mm_packus_epi16(BlendWide(srcTermLo, invAlphaLo, _mm_unpacklo_epi8(dst, zero)),
+							BlendWide(srcTermHi, invAlphaHi, _mm_unpackhi_epi8(dst, zero)));
+}
+
+// Colors of the 4 pixels from x, like PlaneColor
+static inline __m128i PlaneColors4(const SoftSetup* setup, int x, int y)
+{
+	__m128 dx = _mm_add_ps(_mm_set1_ps((float)(x - setup->minX)), _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f));
+	__m128 dy = _mm_set1_ps((float)(y - setup->minY));
+	__m128i color = _mm_setzero_si128();
+	for (int ch = 0; ch < 4; ch++)
+	{
+		__m128 v = _mm_add_ps(_mm_add_ps(_mm_set1_ps(setup->planes[ch][2]), _mm_mul_ps(_mm_set1_ps(setup->planes[ch][0]), dx)),
+							  _mm_mul_ps(_mm_set1_ps(setup->planes[ch][1]), dy));
+		v = _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(255.0f));
+		__m128i channel = _mm_cvttps_epi32(_mm_add_ps(v, _mm_set1_ps(0.5f)));
+		color = _mm_or_si128(color, _mm_slli_epi32(channel, 8 * ch));
+	}
+	return color;
+}
+
+// The edges in crossing (a mask) pass through the block, the block is inside the others. Their edge
+// functions are stepped in 32 bits 4 pixels at a time, e is at the block's first pixel. Only the rows
+// and the halves of rows in the triangle's bounds are walked
+static void DrawBlock(const SoftPrim* prim, const SoftSetup* setup, int blockX, int blockY, const int64_t* e, int crossing)
+{
+	if (setup->wide && crossing)
+	{
+		DrawBlockScalar(prim, setup, blockX, blockY);
+		return;
+	}
+
+	int rowBegin = SOFT_MAX(setup->minY - blockY, 0);
+	int rowEnd = SOFT_MIN(setup->maxY - blockY, SOFT_BLOCK_SIZE - 1);
+	int halfBegin = SOFT_MAX(setup->minX - blockX, 0) / 4;
+	int halfEnd = SOFT_MIN(setup->maxX - blockX, SOFT_BLOCK_SIZE - 1) / 4;
+	__m128i rowEdge[3];
+	__m128i halfStep[3];
+	__m128i rowStep[3];
+	int edgeCount = 0;
+	for (int i = 0; i < 3; i++)
+	{
+		if (!(crossing & (1 << i))) continue;
+		int stepX = setup->a[i] * SOFT_SUBPIXEL;
+		int stepY = setup->b[i] * SOFT_SUBPIXEL;
+		int first = (int)e[i] + rowBegin * stepY + halfBegin * 4 * stepX;
+		rowEdge[edgeCount] = _mm_add_epi32(_mm_set1_epi32(first), _mm_setr_epi32(0, stepX, 2 * stepX, 3 * stepX));
+		halfStep[edgeCount] = _mm_set1_epi32(4 * stepX);
+		rowStep[edgeCount] = _mm_set1_epi32(stepY);
+		edgeCount++;
+	}
+
+	__m128i zero = _mm_setzero_si128();
+	__m128i flatTermLo, flatInvAlpha;
+	BlendTerms(_mm_unpacklo_epi8(_mm_set1_epi32((int)prim->verts[0].color32), zero), &flatTermLo, &flatInvAlpha);
+	Color32* row = &framebuffer.pixels[(size_t)(blockY + rowBegin) * framebuffer.stride + blockX];
+	for (int y = rowBegin; y <= rowEnd; y++, row += framebuffer.stride)
+	{
+		for (int h = halfBegin; h <= halfEnd; h++)
+		{
+			// Sign bits of the edge functions, set outside
+			__m128i outside = zero;
+			for (int i = 0; i < edgeCount; i++)
+			{
+				__m128i edge = h > halfBegin ? _mm_add_epi32(rowEdge[i], halfStep[i]) : rowEdge[i];
+				outside = _mm_or_si128(outside, edge);
+			}
+			outside = _mm_srai_epi32(outside, 31);
+			if (_mm_movemask_epi8(outside) == 0xffff) continue;
+
+			__m128i* pixels = (__m128i*)(row + 4 * h);
+			__m128i dst = _mm_loadu_si128(pixels);
+			__m128i result;
+			if (setup->flat)
+			{
+				result = _mm_packus_epi16(BlendWide(flatTermLo, flatInvAlpha, _mm_unpacklo_epi8(dst, zero)),
+										  BlendWide(flatTermLo, flatInvAlpha, _mm_unpackhi_epi8(dst, zero)));
+			}
+			else
+			{
+				result = Blend4(PlaneColors4(setup, blockX + 4 * h, blockY + y), dst);
+			}
+			_mm_storeu_si128(pixels, _mm_or_si128(_mm_and_si128(outside, dst), _mm_andnot_si128(outside, result)));
+		}
+		for (int i = 0; i < edgeCount; i++)
+		{
+			rowEdge[i] = _mm_add_epi32(rowEdge[i], rowStep[i]);
+		}
+	}
+}
+#else
+static void DrawBlock(const SoftPrim* prim, const SoftSetup* setup, int blockX, int blockY, const int64_t* e, int crossing)
+{
+	DrawBlockScalar(prim, setup, blockX, blockY);
+}
+#endif
+
+// The part of the triangle in the tile, by blocks: skipped when outside an edge, edges with the whole
+// block inside aren't tested
+static void RasterTriangle(const SoftPrim* prim, const SoftSetup* setup, int tileX, int tileY)
+{
+	int minX = SOFT_MAX(setup->minX, tileX) & ~(SOFT_BLOCK_SIZE - 1);
+	int minY = SOFT_MAX(setup->minY, tileY) & ~(SOFT_BLOCK_SIZE - 1);
+	int maxX = SOFT_MIN(setup->maxX, tileX + SOFT_TILE_SIZE - 1);
+	int maxY = SOFT_MIN(setup->maxY, tileY + SOFT_TILE_SIZE - 1);
+	const int64_t blockSpan = (SOFT_BLOCK_SIZE - 1) << SOFT_SUBPIXEL_BITS;
+	for (int blockY = minY; blockY <= maxY; blockY += SOFT_BLOCK_SIZE)
+	{
+		int64_t sampleY = ((int64_t)blockY << SOFT_SUBPIXEL_BITS) + SOFT_SUBPIXEL / 2;
+		for (int blockX = minX; blockX <= maxX; blockX += SOFT_BLOCK_SIZE)
+		{
+			int64_t sampleX = ((int64_t)blockX << SOFT_SUBPIXEL_BITS) + SOFT_SUBPIXEL / 2;
+			int64_t e[3];
+			int crossing = 0;
+			bool outside = false;
+			for (int i = 0; i < 3; i++)
+			{
+				e[i] = setup->a[i] * sampleX + setup->b[i] * sampleY + setup->c[i];
+				int64_t spanX = setup->a[i] * blockSpan;
+				int64_t spanY = setup->b[i] * blockSpan;
+				int64_t eMax = e[i] + SOFT_MAX(spanX, 0) + SOFT_MAX(spanY, 0);
+				int64_t eMin = e[i] + SOFT_MIN(spanX, 0) + SOFT_MIN(spanY, 0);
+				if (eMax < 0) outside = true;
+				if (eMin < 0) crossing |= 1 << i;
+			}
+			if (!outside) DrawBlock(prim, setup, blockX, blockY, e, crossing);
+		}
+	}
+}
+
+static void RasterLine(const SoftPrim* prim, const SoftSetup* setup, int tileX, int tileY)
+{
+	SoftLine line;
+	SnapLine(prim, &line);
+	int majorTile = line.xMajor ? tileX : tileY;
+	int minorTile = line.xMajor ? tileY : tileX;
+	int majorSize = line.xMajor ? framebuffer.width : framebuffer.height;
+	int minorSize = line.xMajor ? framebuffer.height : framebuffer.width;
+	int first = SOFT_MAX(line.first, majorTile);
+	int last = SOFT_MIN(line.last, SOFT_MIN(majorTile + SOFT_TILE_SIZE, majorSize) - 1);
+	int minorEnd = SOFT_MIN(minorTile + SOFT_TILE_SIZE, minorSize);
+
+	// Pixel of the minor axis at a center, the lower one when the line is on the boundary of two:
+	// ceil((minor0 + (center - major0) * dMinor / dMajor) / SOFT_SUBPIXEL) - 1
+	int64_t dMajor = line.major1 - line.major0;
+	int64_t dMinor = line.minor1 - line.minor0;
+	int64_t den = dMajor * SOFT_SUBPIXEL;
+	if (dMajor < 0)
+	{
+		dMajor = -dMajor;
+		dMinor = -dMinor;
+		den = -den;
+	}
+	for (int i = first; i <= last; i++)
+	{
+		int64_t t = ((int64_t)i << SOFT_SUBPIXEL_BITS) + SOFT_SUBPIXEL / 2 - line.major0;
+		int64_t num = (int64_t)line.minor0 * dMajor + t * dMinor - 1;
+		int j = (int)(num >= 0 ? num / den : -((-num + den - 1) / den));
+		if (j < minorTile || j >= minorEnd) continue;
+
+		Color32 src = prim->verts[0].color32;
+		if (!setup->flat)
+		{
+			// Linear along the line
+			float f = (float)t / (float)(line.major1 - line.major0);
+			Color32 src1 = prim->verts[1].color32;
+			src = 0;
+			for (int s = 0; s < 32; s += 8)
+			{
+				float v0 = (float)((prim->verts[0].color32 >> s) & 0xff);
+				float v = v0 + f * ((float)((src1 >> s) & 0xff) - v0);
+				v = fminf(fmaxf(v, 0.0f), 255.0f);
+				src |= (Color32)(int)(v + 0.5f) << s;
+			}
+		}
+		Color32* pixel = line.xMajor ? &framebuffer.pixels[(size_t)j * framebuffer.stride + i] : &framebuffer.pixels[(size_t)i * framebuffer.stride + j];
+		*pixel = BlendPixel(src, *pixel);
+	}
+}
+
+static void RasterTiles(void* context, int begin, int end, int threadIndex)
+{
+	for (int tile = begin; tile < end; tile++)
+	{
+		int tileX = (tile % tilesX) * SOFT_TILE_SIZE;
+		int tileY = (tile / tilesX) * SOFT_TILE_SIZE;
+		if (clearPending)
+		{
+			int width = SOFT_MIN(SOFT_TILE_SIZE, framebuffer.width - tileX);
+			int height = SOFT_MIN(SOFT_TILE_SIZE, framebuffer.height - tileY);
+			for (int y = tileY; y < tileY + height; y++)
+			{
+				Color32* row = &framebuffer.pixels[(size_t)y * framebuffer.stride + tileX];
+				for (int x = 0; x < width; x++)
+				{
+					row[x] = clearColor;
+				}
+			}
+		}
+
+		// Bins in primitive order, so each pixel is blended in the order the primitives were drawn
+		for (int b = 0; b < binCount; b++)
+		{
+			const SoftBin* bin = &bins[b];
+			for (int i = bin->tileStart[tile]; i < bin->tileStart[tile + 1]; i++)
+			{
+				int p = bin->items[i];
+				if (prims[p].type == SOFT_PRIM_TRIANGLE) RasterTriangle(&prims[p], &setups[p], tileX, tileY);
+				else RasterLine(&prims[p], &setups[p], tileX, tileY);
+			}
+		}
+	}
+}
+
+void SoftRenderer_Flush()
+{
+	assert(framebuffer.pixels);
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	int tileCount = tilesX * tilesY;
+	binCount = (primCount + SOFT_BIN_BATCH - 1) / SOFT_BIN_BATCH;
+	if (binCount > binCapacity)
+	{
+		bins = (SoftBin*)realloc(bins, sizeof(SoftBin) * binCount);
+		for (int b = binCapacity; b < binCount; b++)
+		{
+			bins[b].tileStart = (int*)malloc(sizeof(int) * (tileCount + 1));
+			bins[b].items = NULL;
+			bins[b].itemCapacity = 0;
+		}
+		binCapacity = binCount;
+	}
+
+	Jobs_ParallelFor(primCount, SOFT_BIN_BATCH, BinPrims, NULL);
+	if (binCount > 0 || clearPending) Jobs_ParallelFor(tileCount, 1, RasterTiles, NULL);
+
+	memset(&stats, 0, sizeof(stats));
+	stats.triangles = triangleCount;
+	stats.lines = lineCount;
+	for (int b = 0; b < binCount; b++)
+	{
+		stats.binned += bins[b].tileStart[tileCount];
+	}
+	primCount = 0;
+	triangleCount = 0;
+	lineCount = 0;
+	clearPending = false;
+	stats.milliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+const SoftFramebuffer* SoftRenderer_GetFramebuffer()
+{
+	return &framebuffer;
+}
+
+const SoftRendererStats* SoftRenderer_GetStats()
+{
+	return &stats;
+}
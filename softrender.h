@@ -0,0 +1,39 @@
+#pragma once
+#include "render.h"
+
+// CPU rasterizer for the draw lists, to render replays and visual tests on machines without a GPU.
+// SoftRenderer_Init makes DrawList_Draw send the triangles and lines here (see DrawList_SetDrawFunc),
+// so the frame is recorded, rendered and submitted as usual and SoftRenderer_Flush draws it into an
+// RGBA framebuffer. The lists must be in plain memory. While it is on the renderer tessellates the n-gons
+// it would instance, and DrawText (text.h) draws nothing, there are no textures here.
+// Vertex units are framebuffer pixels, origin at the bottom left like the game's projection, and pixel
+// centers are sampled. Primitives are binned into SOFT_TILE_SIZE square tiles and the tiles rasterized
+// on the job workers (jobs.h), each tile by one thread in submission order, so a frame comes out the
+// same for any thread count. Blending is GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA on all four channels of
+// an 8 bit framebuffer.
+
+#define SOFT_TILE_SIZE	64
+
+struct SoftFramebuffer
+{
+	Color32* pixels;	// rows bottom up, like glReadPixels
+	int width;
+	int height;
+	int stride;			// pixels from one row to the next
+};
+
+struct SoftRendererStats
+{
+	int triangles;
+	int lines;
+	int binned;			// primitive references in the tiles
+	float milliseconds;	// of the last flush
+};
+
+void SoftRenderer_Init(int width, int height);
+void SoftRenderer_Shutdown(); // DrawList_Draw goes back to GL
+void SoftRenderer_Clear(Color32 color32); // at the start of the next flush, drops what was drawn before it
+void SoftRenderer_DrawChunk(const DrawVert* verts, int vertCount, const DrawIdx* idxs, int idxCount, unsigned int mode);
+void SoftRenderer_Flush(); // rasterizes what was drawn since the last flush
+const SoftFramebuffer* SoftRenderer_GetFramebuffer();
+const SoftRendererStats* SoftRenderer_GetStats(); // of the last flush
@@ -0,0 +1,176 @@
+#include <string.h>
+#include <stdlib.h>
+#include <assert.h>
+#include "streambuffer.h"
+
+#define STREAM_FENCE_TIMEOUT	1000000000ULL	// ns, per wait call, the waits are retried until the fence signals
+
+static StreamPath maxPath = STREAM_PATH_PERSISTENT;
+
+void StreamBuffer_SetMaxPath(StreamPath path)
+{
+	maxPath = path;
+}
+
+const char* StreamBuffer_GetPathName(StreamPath path)
+{
+	switch (path)
+	{
+	case STREAM_PATH_PERSISTENT:	return "persistent";
+	case STREAM_PATH_ORPHAN:		return "orphan";
+	default:						return "client_arrays";
+	}
+}
+
+void StreamBuffer_InitBytes(StreamBuffer* stream, int vertBytes, int idxBytes, bool clientArrays)
+{
+	memset(stream, 0, sizeof(*stream));
+	stream->vertBytes = vertBytes;
+	stream->idxBytes = idxBytes;
+	stream->path = STREAM_PATH_CLIENT_ARRAYS;
+	if (gl.buffers) stream->path = STREAM_PATH_ORPHAN;
+	if (gl.bufferStorage && gl.sync) stream->path = STREAM_PATH_PERSISTENT;
+	if (stream->path > maxPath) stream->path = maxPath;
+	if (clientArrays) stream->path = STREAM_PATH_CLIENT_ARRAYS;
+
+	switch (stream->path)
+	{
+	case STREAM_PATH_CLIENT_ARRAYS:
+		stream->verts[0] = malloc(vertBytes);
+		stream->idxs[0] = idxBytes > 0 ? malloc(idxBytes) : NULL;
+		break;
+	case STREAM_PATH_ORPHAN:
+		gl.GenBuffers(STREAM_BUFFER_FRAMES, stream->vbos);
+		if (idxBytes > 0) gl.GenBuffers(STREAM_BUFFER_FRAMES, stream->ibos);
+		break;
+	case STREAM_PATH_PERSISTENT:
+	{
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		gl.GenBuffers(STREAM_BUFFER_FRAMES, stream->vbos);
+		if (idxBytes > 0) gl.GenBuffers(STREAM_BUFFER_FRAMES, stream->ibos);
+		for (int s = 0; s < STREAM_BUFFER_FRAMES; s++)
+		{
+			gl.BindBuffer(GL_ARRAY_BUFFER, stream->vbos[s]);
+			gl.BufferStorage(GL_ARRAY_BUFFER, vertBytes, NULL, flags);
+			stream->verts[s] = gl.MapBufferRange(GL_ARRAY_BUFFER, 0, vertBytes, flags);
+			assert(stream->verts[s]);
+			if (idxBytes == 0) continue;
+			gl.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, stream->ibos[s]);
+			gl.BufferStorage(GL_ELEMENT_ARRAY_BUFFER, idxBytes, NULL, flags);
+			stream->idxs[s] = gl.MapBufferRange(GL_ELEMENT_ARRAY_BUFFER, 0, idxBytes, flags);
+			assert(stream->idxs[s]);
+		}
+		gl.BindBuffer(GL_ARRAY_BUFFER, 0);
+		gl.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	} break;
+	}
+}
+
+void StreamBuffer_Free(StreamBuffer* stream)
+{
+	if (stream->path == STREAM_PATH_CLIENT_ARRAYS)
+	{
+		free(stream->verts[0]);
+		free(stream->idxs[0]);
+	}
+	else
+	{
+		for (int s = 0; s < STREAM_BUFFER_FRAMES; s++)
+		{
+			if (stream->fences[s]) gl.DeleteSync(stream->fences[s]);
+		}
+		gl.DeleteBuffers(STREAM_BUFFER_FRAMES, stream->vbos);
+		if (stream->idxBytes > 0) gl.DeleteBuffers(STREAM_BUFFER_FRAMES, stream->ibos);
+	}
+	memset(stream, 0, sizeof(*stream));
+}
+
+static void Unmap(StreamBuffer* stream)
+{
+	gl.BindBuffer(GL_ARRAY_BUFFER, stream->vbos[stream->slot]);
+	gl.UnmapBuffer(GL_ARRAY_BUFFER);
+	if (stream->idxBytes > 0)
+	{
+		gl.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, stream->ibos[stream->slot]);
+		gl.UnmapBuffer(GL_ELEMENT_ARRAY_BUFFER);
+	}
+	stream->mapped = false;
+}
+
+void StreamBuffer_Map(StreamBuffer* stream)
+{
+	if (stream->path == STREAM_PATH_CLIENT_ARRAYS)
+	{
+		stream->writeVerts = stream->verts[0];
+		stream->writeIdxs = stream->idxs[0];
+		return;
+	}
+
+	if (stream->mapped) Unmap(stream); // nothing was drawn last frame
+	stream->slot = (stream->slot + 1) % STREAM_BUFFER_FRAMES;
+	int s = stream->slot;
+	if (stream->path == STREAM_PATH_PERSISTENT)
+	{
+		if (stream->fences[s])
+		{
+			// Drawn STREAM_BUFFER_FRAMES frames ago, this only blocks if the GPU is that far behind
+			GLenum result;
+			do
+			{
+				result = gl.ClientWaitSync(stream->fences[s], GL_SYNC_FLUSH_COMMANDS_BIT, STREAM_FENCE_TIMEOUT);
+			} while (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED && result != GL_WAIT_FAILED);
+			gl.DeleteSync(stream->fences[s]);
+			stream->fences[s] = NULL;
+		}
+	}
+	else
+	{
+		// Orphaning: the old storage stays alive for draws in flight, so the map doesn't have to wait on them
+		gl.BindBuffer(GL_ARRAY_BUFFER, stream->vbos[s]);
+		gl.BufferData(GL_ARRAY_BUFFER, stream->vertBytes, NULL, GL_STREAM_DRAW);
+		stream->verts[s] = gl.MapBufferRange(GL_ARRAY_BUFFER, 0, stream->vertBytes, GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+		gl.BindBuffer(GL_ARRAY_BUFFER, 0);
+		assert(stream->verts[s]);
+		if (stream->idxBytes > 0)
+		{
+			gl.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, stream->ibos[s]);
+			gl.BufferData(GL_ELEMENT_ARRAY_BUFFER, stream->idxBytes, NULL, GL_STREAM_DRAW);
+			stream->idxs[s] = gl.MapBufferRange(GL_ELEMENT_ARRAY_BUFFER, 0, stream->idxBytes, GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+			gl.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+			assert(stream->idxs[s]);
+		}
+		stream->mapped = true;
+	}
+	stream->writeVerts = stream->verts[s];
+	stream->writeIdxs = stream->idxs[s];
+}
+
+void StreamBuffer_Bind(StreamBuffer* stream)
+{
+	if (stream->path == STREAM_PATH_CLIENT_ARRAYS)
+	{
+		stream->drawVerts = (const unsigned char*)stream->verts[0];
+		stream->drawIdxs = stream->idxs[0];
+		return;
+	}
+
+	if (stream->mapped) Unmap(stream);
+	gl.BindBuffer(GL_ARRAY_BUFFER, stream->vbos[stream->slot]);
+	if (stream->idxBytes > 0) gl.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, stream->ibos[stream->slot]);
+	stream->drawVerts = NULL;
+	stream->drawIdxs = NULL;
+}
+
+void StreamBuffer_Unbind(StreamBuffer* stream)
+{
+	if (stream->path == STREAM_PATH_CLIENT_ARRAYS) return;
+
+	gl.BindBuffer(GL_ARRAY_BUFFER, 0);
+	if (stream->idxBytes > 0) gl.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	if (stream->path == STREAM_PATH_PERSISTENT)
+	{
+		int s = stream->slot;
+		if (stream->fences[s]) gl.DeleteSync(stream->fences[s]);
+		stream->fences[s] = gl.FenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+}
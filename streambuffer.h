@@ -0,0 +1,51 @@
+#pragma once
+#include "glapi.h"
+
+// GL buffer storage for data rewritten every frame (draw list chunks, instance records),
+// written in place so the draw doesn't have the driver copy client arrays. A ring of
+// STREAM_BUFFER_FRAMES buffer pairs, one per frame, so the pair written this frame isn't one the GPU may
+// still be reading.
+// Paths, the best one the context has is used:
+//  persistent:    every pair mapped once (ARB_buffer_storage), a fence per pair is waited on before reuse
+//  orphan:        the pair is re-specified and mapped every frame, unmapped right before the draw
+//  client arrays: no mappable buffer objects, malloc'd arrays drawn like before
+
+#define STREAM_BUFFER_FRAMES	3
+
+enum StreamPath
+{
+	STREAM_PATH_CLIENT_ARRAYS = 0,
+	STREAM_PATH_ORPHAN,
+	STREAM_PATH_PERSISTENT,
+};
+
+struct StreamBuffer
+{
+	StreamPath path;
+	int vertBytes;
+	int idxBytes;	// 0 for no index buffer
+	int slot;		// ring pair of this frame
+	bool mapped;	// orphan path, between Map and Bind
+	GLuint vbos[STREAM_BUFFER_FRAMES];
+	GLuint ibos[STREAM_BUFFER_FRAMES];
+	void* verts[STREAM_BUFFER_FRAMES];	// mappings of the pairs, just [0] for client arrays
+	void* idxs[STREAM_BUFFER_FRAMES];
+	GLsync fences[STREAM_BUFFER_FRAMES];
+
+	// Set by Map: where this frame's data is written
+	void* writeVerts;
+	void* writeIdxs;
+	// Set by Bind: what gl*Pointer offsets and glDrawElements indices are relative to
+	const unsigned char* drawVerts;
+	const void* drawIdxs;
+};
+
+// needs GlApi_Load, unless clientArrays: plain memory that any thread can Map and write, no GL calls
+void StreamBuffer_InitBytes(StreamBuffer* stream, int vertBytes, int idxBytes, bool clientArrays = false);
+void StreamBuffer_Free(StreamBuffer* stream);	// GL keeps the storage until draws in flight are done
+void StreamBuffer_Map(StreamBuffer* stream);	// moves to the next pair of the ring
+void StreamBuffer_Bind(StreamBuffer* stream);	// ends the writes, binds the pair for drawing
+void StreamBuffer_Unbind(StreamBuffer* stream);	// after the draws of the frame
+// Caps the path the next StreamBuffer_InitBytes pick, to compare them
+void StreamBuffer_SetMaxPath(StreamPath path);
+const char* StreamBuffer_GetPathName(StreamPath path); // "persistent", "orphan" or "client_arrays"
@@ -0,0 +1,103 @@
+// Wrap test: with Collisions_SetWrap on, only colliders that both have wrap set touch across the screen
+// edges. A non-wrapping collider just outside one edge must not hit a wrapping one at the opposite edge,
+// nor one a screen width away. Checked with the brute force and grid broadphases, exits non zero on
+// failure. Build from the tests folder with:
+//   g++ -O2 -pthread -I.. collision_wrap_test.cpp ../collision.cpp ../aabbtree.cpp ../narrowphase.cpp ../jobs.cpp -o collision_wrap_test
+#include <stdio.h>
+#include "asteroids.h"
+#include "collision.h"
+#include "debugrender.h"
+
+#define TEST_SCREEN_SIZE	1000.0f
+
+// collision.cpp needs these from the game and the debug renderer
+Game game;
+void Debug_DrawCircle(Vector2 pos, float radius, Color32 color32) {}
+void Debug_DrawFilledRect(Rect rect, Color32 color32) {}
+
+static int hits;
+
+static void CountHit(Collider* collider, Collider* otherCollider)
+{
+	hits++;
+}
+
+static Collider MakeCollider(int layer, float radius, bool wrap)
+{
+	Collider collider = {};
+	collider.colliderType = COLLIDER_CIRCLE;
+	collider.layer = layer;
+	collider.circle.localPos = VECTOR2_ZERO;
+	collider.circle.radius = radius;
+	collider.wrap = wrap;
+	collider.collisionCallback = &CountHit;
+	return collider;
+}
+
+// Hits of one check with colliders a and b at posA and posB, seen from both sides
+static int CheckPair(BroadphaseType broadphase, bool wrapA, Vector2 posA, bool wrapB, Vector2 posB)
+{
+	// Layer 0 wraps like the ship, layer 1 like the asteroids, they only collide with each other
+	unsigned int masks[2] = { COLLISION_LAYER_BIT(1), COLLISION_LAYER_BIT(0) };
+	Collisions_Init(masks, 2, broadphase);
+	Collisions_SetWrap(true);
+	static Collider a, b;
+	a = MakeCollider(0, 15.0f, wrapA);
+	b = MakeCollider(1, 20.0f, wrapB);
+	Collisions_AddCollider(&a, posA);
+	Collisions_AddCollider(&b, posB);
+	hits = 0;
+	Collisions_NewFrame();
+	Collisions_CheckCollisions();
+	return hits;
+}
+
+struct WrapCase
+{
+	const char* name;
+	bool wrapA;
+	Vector2 posA;
+	bool wrapB;
+	Vector2 posB;
+	int hits;
+};
+
+int main()
+{
+	game.screenRect = RectNew(VECTOR2_ZERO, V2(TEST_SCREEN_SIZE, TEST_SCREEN_SIZE));
+	game.deltaT = 1.0f / 60.0f;
+
+	const WrapCase cases[] = {
+		{ "outside right edge",		true, V2(5.0f, 500.0f),	false, V2(TEST_SCREEN_SIZE + 10.0f, 500.0f),	0 },
+		{ "outside bottom edge",	true, V2(500.0f, 5.0f),	false, V2(500.0f, TEST_SCREEN_SIZE + 10.0f),	0 },
+		{ "outside left edge",		true, V2(995.0f, 500.0f),	false, V2(-10.0f, 500.0f),						0 },
+		{ "a screen away",			true, V2(500.0f, 500.0f),	false, V2(500.0f + TEST_SCREEN_SIZE, 500.0f),	0 },
+		{ "both wrap",				true, V2(5.0f, 500.0f),	true,  V2(TEST_SCREEN_SIZE + 10.0f, 500.0f),	2 },
+		{ "both wrap, far corners",	true, V2(5.0f, 5.0f),		true,  V2(995.0f, 995.0f),						2 },
+		{ "next to each other",		true, V2(990.0f, 500.0f),	false, V2(TEST_SCREEN_SIZE + 10.0f, 500.0f),	2 },
+	};
+	const BroadphaseType broadphases[] = { BROADPHASE_BRUTE_FORCE, BROADPHASE_GRID };
+	const char* broadphaseNames[] = { "brute_force", "grid" };
+
+	int failures = 0;
+	for (int p = 0; p < 2; p++)
+	{
+		for (int c = 0; c < (int)(sizeof(cases) / sizeof(cases[0])); c++)
+		{
+			const WrapCase* wrapCase = &cases[c];
+			int count = CheckPair(broadphases[p], wrapCase->wrapA, wrapCase->posA, wrapCase->wrapB, wrapCase->posB);
+			if (count != wrapCase->hits)
+			{
+				printf("FAIL %s %s: %d hits, expected %d\n", broadphaseNames[p], wrapCase->name, count, wrapCase->hits);
+				failures++;
+			}
+		}
+	}
+	if (failures > 0)
+	{
+		printf("%d failed\n", failures);
+		return 1;
+	}
+	printf("OK\n");
+	return 0;
+}
@@ -2,6 +2,9 @@
 #define STB_TRUETYPE_IMPLEMENTATION  // force following include to generate implementation
 #include <stb_truetype.h>
 #include <GLFW/glfw3.h>
+#include <stdlib.h>
+#include "renderqueue.h"
+#include "render.h"
 
 unsigned char ttf_buffer[1 << 20];
 unsigned char temp_bitmap[512 * 512];
@@ -9,6 +12,44 @@ unsigned char temp_bitmap[512 * 512];
 stbtt_bakedchar cdata[96]; // ASCII 32..126 is 95 glyphs
 GLuint ftex;
 
+struct TextVert
+{
+	float x, y;
+	float s, t;
+};
+
+// Glyph quads of the frame, drawn at once by the text command of the render queue
+static TextVert* textVerts;
+static int textVertCount;
+static int maxTextVertCount;	// grows when a frame has more
+static bool textQueued;
+
+static void BeginText(unsigned int texture)
+{
+	glEnable(GL_TEXTURE_2D);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	glDisableClientState(GL_COLOR_ARRAY);
+	glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
+}
+
+static void EndText(unsigned int texture)
+{
+	glEnableClientState(GL_COLOR_ARRAY);
+	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glDisable(GL_TEXTURE_2D);
+}
+
+static void DrawTextVerts(void* context)
+{
+	glVertexPointer(2, GL_FLOAT, sizeof(TextVert), &textVerts[0].x);
+	glTexCoordPointer(2, GL_FLOAT, sizeof(TextVert), &textVerts[0].s);
+	glDrawArrays(GL_QUADS, 0, textVertCount);
+	textVertCount = 0;
+	textQueued = false;
+}
+
 void TextInit()
 {
 	fread(ttf_buffer, 1, 1 << 20, fopen("C:/Windows/Fonts/consola.ttf", "rb"));
@@ -19,25 +60,41 @@ void TextInit()
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, 512, 512, 0, GL_ALPHA, GL_UNSIGNED_BYTE, temp_bitmap);
 	// can free temp_bitmap at this point
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	RenderQueue_SetPrimitiveState(RENDER_PRIMITIVE_TEXT, BeginText, EndText);
+}
+
+static TextVert* PushTextVerts(int count)
+{
+	if (textVertCount + count > maxTextVertCount)
+	{
+		while (textVertCount + count > maxTextVertCount) maxTextVertCount = maxTextVertCount ? 2 * maxTextVertCount : 1024;
+		textVerts = (TextVert*)realloc(textVerts, sizeof(TextVert) * maxTextVertCount);
+	}
+	TextVert* verts = &textVerts[textVertCount];
+	textVertCount += count;
+	return verts;
 }
 
 void DrawText(float x, float y, char* text)
 {
 	// assume orthographic projection with units = screen pixels, origin at top left
-	glEnable(GL_TEXTURE_2D);
-	glBindTexture(GL_TEXTURE_2D, ftex);
-	glBegin(GL_QUADS);
+	if (DrawList_GetDrawFunc()) return; // the software renderer has no font texture
+	if (!textQueued)
+	{
+		RenderQueue_Push(RENDER_KEY(RENDER_LAYER_UI, RENDER_PRIMITIVE_TEXT, ftex, 0), DrawTextVerts, NULL);
+		textQueued = true;
+	}
 	while (*text) {
 		if (*text >= 32 && *text < 128) {
 			stbtt_aligned_quad q;
 			stbtt_GetBakedQuad(cdata, 512, 512, *text - 32, &x, &y, &q, 1);//1=opengl & d3d10+,0=d3d9
-			glTexCoord2f(q.s0, q.t1); glVertex2f(q.x0, q.y0);
-			glTexCoord2f(q.s1, q.t1); glVertex2f(q.x1, q.y0);
-			glTexCoord2f(q.s1, q.t0); glVertex2f(q.x1, q.y1);
-			glTexCoord2f(q.s0, q.t0); glVertex2f(q.x0, q.y1);
+			TextVert* v = PushTextVerts(4);
+			v[0].x = q.x0; v[0].y = q.y0; v[0].s = q.s0; v[0].t = q.t1;
+			v[1].x = q.x1; v[1].y = q.y0; v[1].s = q.s1; v[1].t = q.t1;
+			v[2].x = q.x1; v[2].y = q.y1; v[2].s = q.s1; v[2].t = q.t0;
+			v[3].x = q.x0; v[3].y = q.y1; v[3].s = q.s0; v[3].t = q.t0;
 		}
 		++text;
 	}
-	glEnd();
-	glBindTexture(GL_TEXTURE_2D, 0);
-}
\ No newline at end of file
+}
@@ -1,4 +1,4 @@
 #pragma once
 
 void TextInit();
-void DrawText(float x, float y, char* text);
\ No newline at end of file
+void DrawText(float x, float y, char* text); // queued, drawn in RENDER_LAYER_UI by RenderQueue_Submit. Not with the software renderer (softrender.h)
\ No newline at end of file
@@ -1,8 +1,12 @@
 #pragma once
 #include <stdlib.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 
 #define OFFSET_OF(_TYPE, _MEMBER)	((size_t)&(((_TYPE*)0)->_MEMBER))
 #define ARRAY_COUNT(A)				(sizeof(A) / sizeof(A[0]))
+#define CONTAINER_OF(_PTR, _TYPE, _MEMBER)	((_TYPE*)((char*)(_PTR) - OFFSET_OF(_TYPE, _MEMBER)))
 
 static inline float Wrapf(float x, float min, float max)
 {
@@ -11,6 +15,30 @@ static inline float Wrapf(float x, float min, float max)
 	return x;
 }
 
+// Index of the lowest set bit, x must not be 0
+static inline int LowestBitIndex(unsigned int x)
+{
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward(&index, x);
+	return (int)index;
+#else
+	return __builtin_ctz(x);
+#endif
+}
+
+// Time stamp counter for cycle breakdowns, 0 where there is none
+static inline unsigned long long ReadCycleCounter()
+{
+#if defined(_MSC_VER)
+	return __rdtsc();
+#elif defined(__x86_64__) || defined(__i386__)
+	return __builtin_ia32_rdtsc();
+#else
+	return 0;
+#endif
+}
+
 static inline float Clampf(float x, float min, float max)
 {
 	if (x > max) return max;
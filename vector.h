@@ -106,7 +106,9 @@ static inline float DegToRad(float deg)
 static inline Vector2 Rotate(Vector2 v, float deg)
 {
 	float theta = DegToRad(deg);
-	return v.x*V2(cosf(theta), sinf(theta)) + v.y*V2(-sinf(theta), cosf(theta));
+	float c = cosf(theta);
+	float s = sinf(theta);
+	return v.x*V2(c, s) + v.y*V2(-s, c);
 }
 
 static inline float Dot(Vector2 v1, Vector2 v2)